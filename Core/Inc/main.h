@@ -51,8 +51,13 @@ extern "C" {
 #define W25Q64_DL_FLAG 0X00000010 // 外部flash下载标志位
 #define W25Q64_XMODEM_FLAG 0X00000020 // 外部flashXMODEM标志位
 #define W25Q64_LOAD_FLAG 0X00000040 // 外部flashXMODEM标志位
+#define IAP_STREAM_FLAG 0X00000080 // 滑动窗口流式传输标志位
+#define IAP_LZSS_FLAG 0X00000100 // 压缩固件解压标志位
+#define IAP_PATCH_FLAG 0X00000200 // 差分补丁应用标志位
 
 #define OTA_SET_FLAG 0XAABB1122 // OTA校验码
+#define OTA_CRC_FLAG 0XAABB3344 // CRC记录有效校验码
+#define OTA_CRC_A_BIT 31 // crc_mask 中A区CRC所在位
 
 /**
  * @brief OTA信息结构体
@@ -60,8 +65,13 @@ extern "C" {
 typedef struct 
 {
     uint32_t ota_flag; // OTA标志位
-    uint32_t firlen[11]; // OTA字节数
+    uint32_t firlen[11]; // OTA字节数 (只使用 0: 外部flash 0号下载区，其余编号记录在外部flash固件目录中)
     uint8_t ota_ver[32];
+    uint32_t fircrc[11]; // 外部flash 0号下载区固件CRC32 (同 firlen 只使用 0)
+    uint32_t a_len; // A区固件字节数
+    uint32_t a_crc; // A区固件CRC32
+    uint32_t crc_flag; // 等于OTA_CRC_FLAG时crc_mask有效
+    uint32_t crc_mask; // bit 0:fircrc[0]有效, bit 31:A区CRC有效
 }OTA_InfoCB;
 
 /**
@@ -69,10 +79,12 @@ typedef struct
 */
 typedef struct 
 {
-    uint8_t updatabuff[F103RC_PAGE_SIZE]; // 内部flash缓冲区
-    uint32_t w25q64_block_num; // 外部flash块索引
+    uint8_t pagebuff[2][F103RC_PAGE_SIZE]; // 乒乓页缓冲区，一页写入flash时另一页继续接收
+    uint8_t *updatabuff; // 当前接收的页缓冲区 (指向 pagebuff 之一)
+    uint32_t w25q64_block_num; // 外部flash固件编号 (0: APP写入的下载区, 其余为固件目录编号)
     uint32_t xmodemTimer;
-    uint32_t xmodemNB;
+    uint32_t xmodemNB; // 已接收包号
+    uint32_t xmodemLen; // 已接收字节数
     uint32_t xmodemcrc;
 }updata_cb;
 
@@ -0,0 +1,27 @@
+#ifndef SCRATCH_H
+#define SCRATCH_H
+
+#include "main.h"
+
+#define SCRATCH_BLOCK 256 // 分配粒度 (字节)
+#define SCRATCH_SIZE (30 * SCRATCH_BLOCK) // 共享缓冲区大小，按同时借用的最大需求：解压窗口2KB + 补丁缓冲512B + 内部flash页缓存2KB + 流式传输重排缓冲3KB
+
+/**
+ * @brief 借用者编号，每个借用者同时只持有一段缓冲区
+ */
+enum
+{
+    SCRATCH_FREE = 0, // 未借出
+    SCRATCH_STMFLASH, // 内部 Flash 页缓存 (页擦除前保存已写入的部分)
+    SCRATCH_NORFLASH, // 外部 Flash 扇区缓存 (norflash_write 读改写)
+    SCRATCH_LZSS,     // 解压窗口
+    SCRATCH_PATCH,    // 差分补丁读/输出缓冲
+    SCRATCH_STREAM,   // 流式传输重排缓冲 (乱序到达的帧)
+    SCRATCH_OWNER_NUM,
+};
+
+void *scratch_borrow(uint8_t owner, uint32_t size);
+void scratch_return(uint8_t owner);
+uint32_t scratch_highwater(void);
+
+#endif // !SCRATCH_H
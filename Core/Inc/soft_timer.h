@@ -0,0 +1,15 @@
+#ifndef SOFT_TIMER_H
+#define SOFT_TIMER_H
+
+#include "main.h"
+
+#define SOFT_TIMER_NUM 4 // 软件定时器个数
+
+typedef void (*soft_timer_cb)(void); // 定时器回调 (在主循环中执行)
+
+void soft_timer_start(soft_timer_cb cb, uint32_t period);
+void soft_timer_tick(void);
+uint8_t soft_timer_pending(void);
+void soft_timer_run(void);
+
+#endif // !SOFT_TIMER_H
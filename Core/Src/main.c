@@ -30,6 +30,9 @@
 #include "24cxx.h"
 #include "stmflash.h"
 #include "bootloader.h"
+#include "crc32.h"
+#include "ota_stream.h"
+#include "soft_timer.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -51,19 +54,40 @@
 
 /* USER CODE BEGIN PV */
 OTA_InfoCB OTA_Info;
-updata_cb updataA;
+updata_cb updataA; // updatabuff 在 main 中设置，不用初始化器 (否则 4KB 页缓冲区进入 .data)
 uint32_t boot_state_flag;
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
 void SystemClock_Config(void);
 /* USER CODE BEGIN PFP */
-
+static void main_periodic(void);
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
 /* USER CODE BEGIN 0 */
 
+/**
+  * @brief  周期任务 (软件定时器每10ms在主循环中调用一次)
+  * @retval None
+  */
+static void main_periodic(void)
+{
+  // 流式传输超时处理 (波特率协商确认、主机断开后恢复波特率)
+  if (boot_state_flag & IAP_STREAM_FLAG) {
+      ota_stream_poll();
+  }
+  // 处理 Xmodem 协议握手（等待连接状态）
+  if (boot_state_flag & IAP_XMODEMC_FLAG) {
+      // 定时发送字符 'C' 请求进入 CRC 校验模式（10ms一次，100次即1秒）
+      if (updataA.xmodemTimer >= 100) {
+          ota_uart_send_byte('C');
+          updataA.xmodemTimer = 0;
+      }
+      updataA.xmodemTimer++;
+  }
+}
+
 /* USER CODE END 0 */
 
 /**
@@ -74,6 +98,14 @@ int main(void)
 {
   /* USER CODE BEGIN 1 */
   uint32_t i = 0;
+  uint32_t rate = 0;
+  uint32_t halfwords = 0;
+  uint32_t skipped = 0;
+  uint32_t erased = 0;
+  uint32_t programmed = 0;
+  uint32_t addr = 0;
+  uint32_t len = 0;
+  UCB_URXBuffptr *frame;
   /* USER CODE END 1 */
 
   /* MCU Configuration--------------------------------------------------------*/
@@ -95,73 +127,87 @@ int main(void)
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
   /* USER CODE BEGIN 2 */
+  updataA.updatabuff = updataA.pagebuff[0];
   delay_init(72);
+  ota_uart_cb_init(); // 先初始化帧队列，再开启接收中断
   ota_uart_init(921600);
-  ota_uart_cb_init();
   iic_init();
   norflash_init();
+  crc32_hw_init();
   at24cxx_read_otaflag();
   bootloader_brance();
+  soft_timer_start(main_periodic, 10);
+  soft_timer_start(norflash_async_poll, 1); // 外部 flash 异步擦写每 1ms 查询一次 BUSY
+  DBGMCU->CR |= DBGMCU_CR_DBG_SLEEP; // WFI 休眠时保持调试器连接
   /* USER CODE END 2 */
   
   /* Infinite loop */
   /* USER CODE BEGIN WHILE */
   while (1)
   {
-    delay_ms(10);
-    // 检查串口接收环形缓冲区是否有新数据（读指针 != 写指针）
-    if (ota_uart_cb.URxDataOUT != ota_uart_cb.URxDataIN) {
+    // 处理串口接收环形缓冲区中的全部数据（读指针 != 写指针）
+    while ((frame = ota_uart_rx_peek()) != NULL) {
         // 调用事件处理函数解析数据包
-        bootloader_event(ota_uart_cb.URxDataOUT->start, ota_uart_cb.URxDataOUT->end - ota_uart_cb.URxDataOUT->start + 1);
-        
-        // 移动读指针到下一个数据块
-        ota_uart_cb.URxDataOUT++;
+        bootloader_event(frame->start, frame->end - frame->start + 1);
         
-        // 如果读指针到达缓冲区末尾，回绕到开头
-        if (ota_uart_cb.URxDataOUT == ota_uart_cb.URxDataEND) {
-            ota_uart_cb.URxDataOUT = (UCB_URXBuffptr *)&ota_uart_cb.URxDataPtr[0];
-        }
+        // 处理完后移出队列
+        ota_uart_rx_pop();
     }
 
-    // 处理 Xmodem 协议握手（等待连接状态）
-    if (boot_state_flag & IAP_XMODEMC_FLAG) {
-        // 定时发送字符 'C' 请求进入 CRC 校验模式（假设此处循环约10ms一次，100次即1秒）
-        if (updataA.xmodemTimer >= 100) {
-            printf("C\r\n");
-            updataA.xmodemTimer = 0;
-        }
-        updataA.xmodemTimer++;
-    }
+    // 执行到期的软件定时器 (Xmodem 'C' 握手、流式传输超时)
+    soft_timer_run();
+
+    // 有页面等待写入时在后台分段写入 flash，收到新数据立即让出
+    bootloader_commit_poll();
 
     // 检查是否有固件搬运标志（从外部 Flash 更新到内部 Flash）
     if ((boot_state_flag & UPDATA_A_FLAG) != 0) {
-        printf("长度:%d字节\r\n", OTA_Info.firlen[updataA.w25q64_block_num]);
+        bootloader_image(updataA.w25q64_block_num, &addr, &len);
+        printf("长度:%lu字节\r\n", len);
         
+        // 搬运前校验外部 Flash 固件，损坏时保留 A 区原有程序
+        if (bootloader_check_slot(updataA.w25q64_block_num) == 0) {
+            boot_state_flag &= ~(UPDATA_A_FLAG);
+        }
         // 校验固件长度是否为 4 字节对齐（STM32 Flash 写入要求必须半字/字对齐）
-        if (OTA_Info.firlen[updataA.w25q64_block_num] % 4 == 0) {
+        else if (len % 4 == 0) {
             
+            // 按固件长度开启 A 区写入会话：与 A 区现有内容比较，相同的页跳过，需要时每页只擦除一次
+            stmflash_session_begin(F103RC_A_SADDR, len);
+            stmflash_perf_reset();
+
             // 循环搬运完整的 Flash 页
-            for (i = 0; i < OTA_Info.firlen[updataA.w25q64_block_num] / F103RC_PAGE_SIZE; i++) {
+            for (i = 0; i < len / F103RC_PAGE_SIZE; i++) {
                 // 从外部 Flash 读取一页数据
-                norflash_read(updataA.updatabuff, i * F103RC_PAGE_SIZE + updataA.w25q64_block_num * 64 * 1024, F103RC_PAGE_SIZE);
+                norflash_read(updataA.updatabuff, addr + i * F103RC_PAGE_SIZE, F103RC_PAGE_SIZE);
                 // 写入到内部 Flash A区
-                stmflash_write(F103RC_A_SADDR + i * F103RC_PAGE_SIZE, (uint16_t *)updataA.updatabuff, F103RC_PAGE_SIZE / 2);
+                stmflash_session_write(updataA.updatabuff, F103RC_PAGE_SIZE);
             }
 
             // 处理不足一页的剩余数据
-            if (OTA_Info.firlen[updataA.w25q64_block_num] % F103RC_PAGE_SIZE != 0) {
+            if (len % F103RC_PAGE_SIZE != 0) {
                 // 读取剩余字节
-                norflash_read(updataA.updatabuff, i * F103RC_PAGE_SIZE + updataA.w25q64_block_num * 64 * 1024, OTA_Info.firlen[updataA.w25q64_block_num] % F103RC_PAGE_SIZE);
+                norflash_read(updataA.updatabuff, addr + i * F103RC_PAGE_SIZE, len % F103RC_PAGE_SIZE);
                 // 写入剩余字节
-                stmflash_write(F103RC_A_SADDR + i * F103RC_PAGE_SIZE, (uint16_t *)updataA.updatabuff, OTA_Info.firlen[updataA.w25q64_block_num] % F103RC_PAGE_SIZE / 2);
+                stmflash_session_write(updataA.updatabuff, len % F103RC_PAGE_SIZE);
             }
+            stmflash_session_end();
+            rate = stmflash_perf_rate(&halfwords);
+            stmflash_session_stat(&skipped, &erased, &programmed);
+            printf("内部flash编程: %lu字节, %lu半字/秒\r\n", halfwords * 2, rate);
+            printf("页: 跳过%lu, 擦除%lu, 编程%lu\r\n", skipped, erased, programmed);
 
             // 如果是主程序块更新，清除 EEPROM 中的 OTA 标志位
             if (updataA.w25q64_block_num == 0) {
                 OTA_Info.ota_flag = 0;
-                at24cxx_write_otainfo();
+            }
+            // 读回 A 区校验，通过后记录 A 区 CRC (同时写入 EEPROM)
+            if (bootloader_check_install(updataA.w25q64_block_num) == 0) {
+                boot_state_flag &= ~(UPDATA_A_FLAG);
+                continue;
             }
             printf("A区更新完毕\r\n");
+            ota_uart_flush();
             
             // 系统复位，跳转运行新程序
             NVIC_SystemReset();
@@ -173,6 +219,15 @@ int main(void)
         } 
     }
 
+    // 没有待处理的事件时休眠，由串口空闲中断或 SysTick 唤醒。
+    // 关中断后再检查一次，检查与 WFI 之间到达的中断会挂起并立即唤醒 WFI。
+    __disable_irq();
+    if (!ota_uart_rx_pending() && !soft_timer_pending() &&
+        !bootloader_commit_busy() && !(boot_state_flag & UPDATA_A_FLAG)) {
+        __WFI();
+    }
+    __enable_irq();
+
 
     /* USER CODE END WHILE */
 
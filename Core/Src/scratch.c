@@ -0,0 +1,77 @@
+/**
+ * @file    scratch.c
+ * @brief   驱动之间共享的临时缓冲区
+ * @details 内部 Flash 页缓存、外部 Flash 扇区缓存、解压窗口、差分补丁缓冲、流式传输重排缓冲不会
+ *          全部同时使用，从同一块静态内存中按 SCRATCH_BLOCK 粒度借出。
+ *          每段缓冲区记录借用者编号，只能由借用者归还；同一借用者再次借用时
+ *          先归还原来的一段。只在主循环中使用，不需要关中断。
+ */
+
+#include "scratch.h"
+
+#define SCRATCH_BLOCKS (SCRATCH_SIZE / SCRATCH_BLOCK)
+
+static uint32_t scratch_pool[SCRATCH_SIZE / 4];  // 按字对齐，借用者可以按半字/字访问
+static uint8_t scratch_owner[SCRATCH_BLOCKS];    // 各块的借用者，SCRATCH_FREE 表示空闲
+static uint8_t scratch_used;                     // 已借出的块数
+static uint8_t scratch_peak;                     // 已借出块数的最大值
+
+/**
+ * @brief  借用一段缓冲区
+ * @details 从低地址开始查找第一段足够长的连续空闲块。
+ * @param  owner 借用者编号
+ * @param  size  字节数
+ * @retval 缓冲区地址，空间不足时为 NULL
+ */
+void *scratch_borrow(uint8_t owner, uint32_t size)
+{
+    uint32_t need = (size + SCRATCH_BLOCK - 1) / SCRATCH_BLOCK;
+    uint32_t start = 0;
+    uint32_t i;
+
+    if ((owner == SCRATCH_FREE) || (owner >= SCRATCH_OWNER_NUM) || (need == 0)) {
+        return NULL;
+    }
+    scratch_return(owner);
+
+    for (i = 0; i < SCRATCH_BLOCKS; i++) {
+        if (scratch_owner[i] != SCRATCH_FREE) {
+            start = i + 1;
+        }
+        else if (i + 1 - start == need) {
+            memset(&scratch_owner[start], owner, need);
+            scratch_used += need;
+            if (scratch_used > scratch_peak) {
+                scratch_peak = scratch_used;
+            }
+            return (uint8_t *)scratch_pool + start * SCRATCH_BLOCK;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief  归还借用者持有的缓冲区
+ * @param  owner 借用者编号，没有持有时不做任何事
+ * @return None
+ */
+void scratch_return(uint8_t owner)
+{
+    uint32_t i;
+
+    for (i = 0; i < SCRATCH_BLOCKS; i++) {
+        if (scratch_owner[i] == owner) {
+            scratch_owner[i] = SCRATCH_FREE;
+            scratch_used--;
+        }
+    }
+}
+
+/**
+ * @brief  同时借出的最大字节数
+ * @return uint32_t 字节数
+ */
+uint32_t scratch_highwater(void)
+{
+    return scratch_peak * SCRATCH_BLOCK;
+}
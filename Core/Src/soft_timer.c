@@ -0,0 +1,91 @@
+/**
+ * @file    soft_timer.c
+ * @brief   基于 SysTick 的软件定时器
+ * @details SysTick 中断 (1ms) 中只做计数并标记到期的定时器，回调在主循环的
+ *          soft_timer_run 中执行，可以安全地调用串口发送、flash 操作等函数。
+ *          主循环没有到期定时器、也没有其他事件时用 WFI 休眠，由下一次中断唤醒。
+ */
+
+#include "soft_timer.h"
+
+/**
+ * @brief 软件定时器
+ */
+typedef struct
+{
+    soft_timer_cb cb;          // 回调，NULL 表示未使用
+    uint32_t period;           // 周期 (ms)
+    uint32_t remain;           // 距离下次到期的剩余时间 (ms)
+    volatile uint8_t pending;  // 已到期，等待主循环执行回调
+}soft_timer;
+
+static soft_timer timers[SOFT_TIMER_NUM];
+static volatile uint8_t timer_pending; // 任一定时器到期
+
+/**
+ * @brief  启动一个周期定时器
+ * @param  cb     回调
+ * @param  period 周期 (ms)
+ * @return None
+ */
+void soft_timer_start(soft_timer_cb cb, uint32_t period)
+{
+    uint8_t i;
+
+    for (i = 0; i < SOFT_TIMER_NUM; i++) {
+        if (timers[i].cb == NULL) {
+            timers[i].period = period;
+            timers[i].remain = period;
+            timers[i].pending = 0;
+            timers[i].cb = cb; // 最后写入回调，中断中看到回调时其余字段已有效
+            return;
+        }
+    }
+}
+
+/**
+ * @brief  定时器计数 (在 SysTick 中断中调用)
+ * @return None
+ */
+void soft_timer_tick(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < SOFT_TIMER_NUM; i++) {
+        if ((timers[i].cb != NULL) && (--timers[i].remain == 0)) {
+            timers[i].remain = timers[i].period;
+            timers[i].pending = 1;
+            timer_pending = 1;
+        }
+    }
+}
+
+/**
+ * @brief  是否有到期的定时器
+ * @retval 1 有
+ * @retval 0 没有
+ */
+uint8_t soft_timer_pending(void)
+{
+    return timer_pending;
+}
+
+/**
+ * @brief  执行到期定时器的回调 (在主循环中调用)
+ * @return None
+ */
+void soft_timer_run(void)
+{
+    uint8_t i;
+
+    if (!timer_pending) {
+        return;
+    }
+    timer_pending = 0;
+    for (i = 0; i < SOFT_TIMER_NUM; i++) {
+        if (timers[i].pending) {
+            timers[i].pending = 0;
+            timers[i].cb();
+        }
+    }
+}
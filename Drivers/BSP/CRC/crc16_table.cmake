@@ -0,0 +1,65 @@
+# 构建时生成 CRC-16/XMODEM (多项式 0x1021) 查找表
+#
+# crc16_generate_table(<输出头文件> <分片数>)
+#   分片数为 1 时只生成 256 项基础表 crc16_table[0]；
+#   分片数为 4 时额外生成 slice-by-4 所需的 crc16_table[1..3]，
+#   crc16_table[k][v] 表示字节 v 后跟 k 个 0 字节时的 CRC。
+
+function(crc16_generate_table OUTPUT SLICES)
+    set(POLY 4129) # 0x1021
+
+    # 基础表：逐位计算每个字节值的 CRC
+    foreach(v RANGE 255)
+        math(EXPR crc "${v} << 8")
+        foreach(bit RANGE 7)
+            math(EXPR top "${crc} & 32768")
+            if(top)
+                math(EXPR crc "((${crc} << 1) ^ ${POLY}) & 65535")
+            else()
+                math(EXPR crc "(${crc} << 1) & 65535")
+            endif()
+        endforeach()
+        set(T0_${v} ${crc})
+    endforeach()
+
+    # 分片表：T[k][v] = (T[k-1][v] << 8) ^ T[0][T[k-1][v] >> 8]
+    math(EXPR last "${SLICES} - 1")
+    if(last GREATER 0)
+        foreach(k RANGE 1 ${last})
+            math(EXPR prev "${k} - 1")
+            foreach(v RANGE 255)
+                math(EXPR hi "${T${prev}_${v}} >> 8")
+                math(EXPR crc "((${T${prev}_${v}} << 8) & 65535) ^ ${T0_${hi}}")
+                set(T${k}_${v} ${crc})
+            endforeach()
+        endforeach()
+    endif()
+
+    set(text "/* 由 crc16_table.cmake 在构建时生成，请勿手动修改 */\n")
+    string(APPEND text "#define CRC16_TABLE_SLICES ${SLICES}\n\n")
+    string(APPEND text "static const uint16_t crc16_table[${SLICES}][256] = {\n")
+    foreach(k RANGE ${last})
+        string(APPEND text "    {\n")
+        foreach(row RANGE 0 255 8)
+            string(APPEND text "       ")
+            math(EXPR end "${row} + 7")
+            foreach(v RANGE ${row} ${end})
+                math(EXPR hex "${T${k}_${v}}" OUTPUT_FORMAT HEXADECIMAL)
+                string(SUBSTRING "${hex}" 2 -1 digits)
+                string(TOUPPER "${digits}" digits)
+                string(LENGTH "${digits}" n)
+                while(n LESS 4)
+                    string(PREPEND digits "0")
+                    math(EXPR n "${n} + 1")
+                endwhile()
+                string(APPEND text " 0X${digits},")
+            endforeach()
+            string(APPEND text "\n")
+        endforeach()
+        string(APPEND text "    },\n")
+    endforeach()
+    string(APPEND text "};\n")
+
+    file(CONFIGURE OUTPUT ${OUTPUT} CONTENT "${text}")
+    set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS ${CMAKE_CURRENT_FUNCTION_LIST_FILE})
+endfunction()
@@ -0,0 +1,24 @@
+/**
+ * @file crc16.h
+ * @brief 查表法 CRC-16/XMODEM (多项式 0x1021, 初值 0, 高位在先)
+ *
+ * 查找表由 crc16_table.cmake 在构建时生成，定义 CRC16_SLICE_BY_4 时
+ * 使用 slice-by-4 (每次处理4字节)。
+ *
+ * 增量用法:
+ *   crc = crc16_init();
+ *   crc = crc16_update(crc, buf1, len1);
+ *   crc = crc16_update(crc, buf2, len2);
+ *   crc = crc16_final(crc);
+ */
+#ifndef CRC16_H
+#define CRC16_H
+
+#include <stdint.h>
+
+uint16_t crc16_init(void);
+uint16_t crc16_update(uint16_t crc, const uint8_t *data, uint32_t len);
+uint16_t crc16_final(uint16_t crc);
+uint16_t crc16_calc(const uint8_t *data, uint32_t len);
+
+#endif // !CRC16_H
@@ -0,0 +1,23 @@
+/**
+ * @file crc32.h
+ * @brief STM32 硬件 CRC32 单元 + DMA 数据输入
+ *
+ * 硬件 CRC 为 CRC-32/MPEG-2 (多项式 0x04C11DB7, 初值 0xFFFFFFFF, 不反转, 无输出异或)，
+ * 按32位字输入，每个字按小端从内存读取。长度不是4的倍数时，末尾不足一个字的
+ * 字节以 0xFF 补齐后输入。
+ */
+#ifndef CRC32_H
+#define CRC32_H
+
+#include "main.h"
+
+#define CRC32_DMA DMA1_Channel1 // 存储器到存储器 DMA 通道
+
+void crc32_hw_init(void);
+void crc32_hw_deinit(void);
+void crc32_hw_reset(void);
+void crc32_hw_update(const uint8_t *data, uint32_t len);
+uint32_t crc32_hw_value(void);
+uint32_t crc32_hw_calc(const uint8_t *data, uint32_t len);
+
+#endif // !CRC32_H
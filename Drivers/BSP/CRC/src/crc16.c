@@ -0,0 +1,68 @@
+/**
+ * @file    crc16.c
+ * @brief   查表法 CRC-16/XMODEM 实现文件
+ * @details 逐位算法每字节需要8次移位和判断，查表法每字节只需一次查表；
+ *          slice-by-4 每4字节查4张表，进一步减少循环与数据依赖。
+ *          结果与原逐位实现 xmodem_crc16 完全一致。
+ */
+
+#include "crc16.h"
+#include "crc16_table.h"
+
+/**
+ * @brief  CRC 初值
+ * @return uint16_t 初始 CRC
+ */
+uint16_t crc16_init(void)
+{
+    return 0x0000;
+}
+
+/**
+ * @brief  增量计算 CRC
+ * @param  crc  上一次的 CRC (首次为 crc16_init() 的返回值)
+ * @param  data 数据
+ * @param  len  数据长度
+ * @return uint16_t 更新后的 CRC
+ */
+uint16_t crc16_update(uint16_t crc, const uint8_t *data, uint32_t len)
+{
+#if defined(CRC16_SLICE_BY_4) && (CRC16_TABLE_SLICES >= 4)
+    uint16_t x;
+
+    // 每次处理4字节：前2字节与当前 CRC 异或后分别经过 3/2 个字节的移位
+    while (len >= 4) {
+        x = crc ^ ((data[0] << 8) | data[1]);
+        crc = crc16_table[3][x >> 8] ^ crc16_table[2][x & 0xFF] ^
+              crc16_table[1][data[2]] ^ crc16_table[0][data[3]];
+        data += 4;
+        len -= 4;
+    }
+#endif
+
+    while (len--) {
+        crc = (crc << 8) ^ crc16_table[0][(crc >> 8) ^ *data++];
+    }
+    return crc;
+}
+
+/**
+ * @brief  CRC 结束处理 (XMODEM 无输出异或)
+ * @param  crc 累计的 CRC
+ * @return uint16_t 最终 CRC
+ */
+uint16_t crc16_final(uint16_t crc)
+{
+    return crc;
+}
+
+/**
+ * @brief  计算一段连续数据的 CRC
+ * @param  data 数据 (RAM 或内部 Flash 地址均可)
+ * @param  len  数据长度
+ * @return uint16_t CRC
+ */
+uint16_t crc16_calc(const uint8_t *data, uint32_t len)
+{
+    return crc16_final(crc16_update(crc16_init(), data, len));
+}
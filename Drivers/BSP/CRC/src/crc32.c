@@ -0,0 +1,114 @@
+/**
+ * @file    crc32.c
+ * @brief   硬件 CRC32 计算实现文件
+ * @details CRC 单元每写一个字到 CRC->DR 即完成一次计算，由 DMA 以存储器到存储器
+ *          方式从 Flash/RAM 直接搬运到 CRC->DR，CPU 无需逐字循环。整个 A 区
+ *          (约 60K 字) 只需几毫秒。
+ */
+
+#include "crc32.h"
+
+DMA_HandleTypeDef g_crc_dma_handle; // CRC 输入 DMA 句柄
+
+/**
+ * @brief  CRC 单元与 DMA 初始化
+ * @return None
+ */
+void crc32_hw_init(void)
+{
+    __HAL_RCC_CRC_CLK_ENABLE();
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    // 存储器到存储器：源地址 (外设地址寄存器) 自增，目标 CRC->DR 固定
+    g_crc_dma_handle.Instance = CRC32_DMA;
+    g_crc_dma_handle.Init.Direction = DMA_MEMORY_TO_MEMORY;
+    g_crc_dma_handle.Init.PeriphInc = DMA_PINC_ENABLE;
+    g_crc_dma_handle.Init.MemInc = DMA_MINC_DISABLE;
+    g_crc_dma_handle.Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
+    g_crc_dma_handle.Init.MemDataAlignment = DMA_MDATAALIGN_WORD;
+    g_crc_dma_handle.Init.Mode = DMA_NORMAL;
+    g_crc_dma_handle.Init.Priority = DMA_PRIORITY_LOW;
+    HAL_DMA_Init(&g_crc_dma_handle);
+
+    crc32_hw_reset();
+}
+
+/**
+ * @brief  关闭 CRC 输入 DMA 通道
+ * @details 跳转 APP 之前调用，把 DMA1 通道1 恢复到复位状态。
+ * @return None
+ */
+void crc32_hw_deinit(void)
+{
+    HAL_DMA_DeInit(&g_crc_dma_handle);
+}
+
+/**
+ * @brief  复位 CRC 计算结果为初值 0xFFFFFFFF
+ * @return None
+ */
+void crc32_hw_reset(void)
+{
+    CRC->CR = CRC_CR_RESET;
+}
+
+/**
+ * @brief  向 CRC 单元输入数据
+ * @details 4字节对齐的数据由 DMA 输入，未对齐时由 CPU 逐字写入。分多次输入时，
+ *          除最后一次外长度必须是4的倍数。
+ *
+ * @param  data 数据 (RAM 或内部 Flash 地址)
+ * @param  len  数据长度 (字节)
+ * @return None
+ */
+void crc32_hw_update(const uint8_t *data, uint32_t len)
+{
+    uint32_t words = len / 4;
+    uint32_t count;
+    uint32_t tail = 0xFFFFFFFF;
+
+    if (((uint32_t)data & 3) == 0) {
+        // 单次 DMA 最多 65535 个字
+        while (words) {
+            count = (words > 0xFFFF) ? 0xFFFF : words;
+            HAL_DMA_Start(&g_crc_dma_handle, (uint32_t)data, (uint32_t)&CRC->DR, count);
+            HAL_DMA_PollForTransfer(&g_crc_dma_handle, HAL_DMA_FULL_TRANSFER, 100);
+            data += count * 4;
+            words -= count;
+        }
+    }
+    else {
+        while (words--) {
+            CRC->DR = __UNALIGNED_UINT32_READ(data);
+            data += 4;
+        }
+    }
+
+    // 末尾不足一个字，以 0xFF 补齐
+    if (len & 3) {
+        memcpy(&tail, data, len & 3);
+        CRC->DR = tail;
+    }
+}
+
+/**
+ * @brief  读取当前 CRC 结果
+ * @return uint32_t CRC32
+ */
+uint32_t crc32_hw_value(void)
+{
+    return CRC->DR;
+}
+
+/**
+ * @brief  计算一段连续数据的 CRC32
+ * @param  data 数据 (RAM 或内部 Flash 地址)
+ * @param  len  数据长度 (字节)
+ * @return uint32_t CRC32
+ */
+uint32_t crc32_hw_calc(const uint8_t *data, uint32_t len)
+{
+    crc32_hw_reset();
+    crc32_hw_update(data, len);
+    return crc32_hw_value();
+}
@@ -33,6 +33,14 @@
 #define NM25Q128    0X5217          /* NM25Q128 оƬID */
 
 extern uint16_t norflash_TYPE;      /* FLASHоƬͺ */
+
+/* ϡд: ҳʱͷ/β0XFF, ȫ0XFFҳ (ĿѲ) */
+#define NORFLASH_SPARSE     1
+
+/* 첽дг */
+#define NORFLASH_ASYNC_NUM  4
+
+typedef void (*norflash_cb)(void);  /* 첽ɻص ( norflash_async_poll е) */
  
 /* ָ */
 #define FLASH_WriteEnable           0x06 
@@ -50,6 +58,7 @@ extern uint16_t norflash_TYPE;      /* 
 #define FLASH_PageProgram           0x02 
 #define FLASH_PageProgramQuad       0x32 
 #define FLASH_BlockErase            0xD8 
+#define FLASH_Block32Erase          0x52 
 #define FLASH_SectorErase           0x20 
 #define FLASH_ChipErase             0xC7 
 #define FLASH_PowerDown             0xB9 
@@ -67,19 +76,28 @@ extern uint16_t norflash_TYPE;      /* 
 // static void norflash_wait_busy(void);               /* ȴ */
 // static void norflash_send_address(uint32_t address);/* ͵ַ */
 // static void norflash_write_page(uint8_t *pbuf, uint32_t addr, uint16_t datalen);    /* дpage */
-// static void norflash_write_nocheck(uint8_t *pbuf, uint32_t addr, uint16_t datalen); /* дflash, */
 
 /* ͨ */
 void norflash_init(void);                   /* ʼ25QXX */
 uint16_t norflash_read_id(void);            /* ȡFLASH ID */
+uint32_t norflash_capacity(void);           /* оƬ(ֽ) */
 void norflash_write_enable(void);           /* дʹ */
 uint8_t norflash_read_sr(uint8_t regno);    /* ȡ״̬Ĵ */
 void norflash_write_sr(uint8_t regno,uint8_t sr);   /* д״̬Ĵ */
 
 void norflash_erase_chip(void);             /* Ƭ */
 void norflash_erase_sector(uint32_t saddr); /*  */
+void norflash_erase_range(uint32_t addr, uint32_t len);    /*  64K/32K/4K ϲ */
 void norflash_read(uint8_t *pbuf, uint32_t addr, uint16_t datalen);     /* ȡflash */
 void norflash_write(uint8_t *pbuf, uint32_t addr, uint16_t datalen);    /* дflash */
+void norflash_write_nocheck(uint8_t *pbuf, uint32_t addr, uint16_t datalen); /* дflash, */
+uint32_t norflash_programmed(void);         /* ȡʵʱ̵ֽ */
+
+/* 첽д: ŶӺ,  norflash_async_poll ƽ; ͬӿڻȵȴ */
+uint8_t norflash_async_erase(uint32_t addr, uint32_t len, norflash_cb cb);                  /* 첽 */
+uint8_t norflash_async_program(uint8_t *pbuf, uint32_t addr, uint16_t datalen, norflash_cb cb); /* 첽д() */
+void norflash_async_poll(void);             /* ƽ첽 */
+uint8_t norflash_async_busy(void);          /* Ƿδɵ첽 */
 
 #endif
 
@@ -24,10 +24,38 @@
 
 #include "spi.h"
 #include "delay.h"
+#include "scratch.h"
 #include "norflash.h"
 
 
 uint16_t g_norflash_type = W25Q64;     /* ĬW25Q64 */
+static uint32_t g_norflash_programmed;  /* ʵʱ̵ֽ (ϡдʱ0XFF) */
+static uint8_t g_norflash_read_cmd = FLASH_ReadData;    /* ָ, norflash_init аоƬѡ */
+
+/* 첽д */
+typedef struct
+{
+    uint8_t type;       /* NORFLASH_OP_ERASE / NORFLASH_OP_PROGRAM */
+    uint8_t *pbuf;      /*  (һҪдֽ) */
+    uint32_t addr;      /* һҪ/дĵַ */
+    uint32_t end;       /* ַ */
+    norflash_cb cb;     /* ɻص, ΪNULL */
+} norflash_op;
+
+#define NORFLASH_OP_ERASE       0
+#define NORFLASH_OP_PROGRAM     1
+
+static struct
+{
+    norflash_op op[NORFLASH_ASYNC_NUM]; /* , ˳ִ */
+    uint8_t head;                       /* ִеĲ */
+    uint8_t count;                      /* еĲ */
+    uint8_t running;                    /* оƬִ op[head] һָ */
+} g_norflash_async;
+
+static void norflash_async_sync(void);
+static uint8_t norflash_program_start(uint8_t *pbuf, uint32_t addr, uint16_t datalen);
+static uint32_t norflash_erase_start(uint32_t addr, uint32_t end);
 
 /**
  * @brief       ʼSPI NOR FLASH
@@ -51,9 +79,29 @@ void norflash_init(void)
     NORFLASH_CS(1);                     /* ȡƬѡ */
 
     spi1_init();                        /* ʼ SPI1 */
-    spi1_set_speed(SPI_SPEED_2);        /* SPI1 л״̬ 36Mhz */
+    spi1_set_speed(SPI_SPEED_4);        /* ʶоƬǰ 18Mhz, κоƬָͨ֧ */
     
     g_norflash_type = norflash_read_id();   /* ȡFLASH ID. */
+
+    switch (g_norflash_type)
+    {
+        case W25Q16:
+        case W25Q32:
+        case W25Q64:
+        case W25Q128:
+        case W25Q256:
+        case BY25Q64:
+        case BY25Q128:
+        case NM25Q64:
+        case NM25Q128:
+            g_norflash_read_cmd = FLASH_FastReadData;   /* ֪оƬ: ٶ(1ֽ)֧Զ 36Mhz ʱ */
+            spi1_set_speed(SPI_SPEED_2);                /* SPI1 л״̬ 36Mhz (APB2 / 2, SPI1 ٶ) */
+            break;
+
+        default:
+            g_norflash_read_cmd = FLASH_ReadData;       /* δ֪оƬ: ͨ,  18Mhz */
+            break;
+    }
     
     if (g_norflash_type == W25Q256)     /* SPI FLASHΪW25Q256, ʹ4ֽڵַģʽ */
     {
@@ -66,7 +114,7 @@ void norflash_init(void)
             norflash_write_sr(3, temp); /* дSR3 */
             
             NORFLASH_CS(0);
-            spi1_read_write_byte(FLASH_Enable4ByteAddr);    /* ʹ4ֽڵַָ */
+            spi1_exchange(FLASH_Enable4ByteAddr);    /* ʹ4ֽڵַָ */
             NORFLASH_CS(1);
         }
     }
@@ -81,7 +129,10 @@ void norflash_init(void)
  */
 static void norflash_wait_busy(void)
 {
-    while ((norflash_read_sr(1) & 0x01) == 0x01);   /*  ȴBUSYλ */
+    NORFLASH_CS(0);
+    spi1_exchange(FLASH_ReadStatusReg1);            /* ƬѡЧʱоƬ״̬Ĵ1 */
+    while ((spi1_exchange(0XFF) & 0x01) == 0x01);   /*  ȴBUSYλ */
+    NORFLASH_CS(1);
 }
 
 /**
@@ -93,7 +144,7 @@ static void norflash_wait_busy(void)
 void norflash_write_enable(void)
 {
     NORFLASH_CS(0);
-    spi1_read_write_byte(FLASH_WriteEnable);   /* дʹ */
+    spi1_exchange(FLASH_WriteEnable);   /* дʹ */
     NORFLASH_CS(1);
 }
 
@@ -107,11 +158,11 @@ static void norflash_send_address(uint32_t address)
 {
     if (g_norflash_type == W25Q256) /*  ֻW25Q256֧4ֽڵַģʽ */
     {
-        spi1_read_write_byte((uint8_t)((address)>>24)); /*  bit31 ~ bit24 ַ */
+        spi1_exchange((uint8_t)((address)>>24)); /*  bit31 ~ bit24 ַ */
     } 
-    spi1_read_write_byte((uint8_t)((address)>>16));     /*  bit23 ~ bit16 ַ */
-    spi1_read_write_byte((uint8_t)((address)>>8));      /*  bit15 ~ bit8  ַ */
-    spi1_read_write_byte((uint8_t)address);             /*  bit7  ~ bit0  ַ */
+    spi1_exchange((uint8_t)((address)>>16));     /*  bit23 ~ bit16 ַ */
+    spi1_exchange((uint8_t)((address)>>8));      /*  bit15 ~ bit8  ַ */
+    spi1_exchange((uint8_t)address);             /*  bit7  ~ bit0  ַ */
 }
 
 /**
@@ -160,8 +211,8 @@ uint8_t norflash_read_sr(uint8_t regno)
     }
 
     NORFLASH_CS(0);
-    spi1_read_write_byte(command);      /* ͶĴ */
-    byte = spi1_read_write_byte(0Xff);  /* ȡһֽ */
+    spi1_exchange(command);      /* ͶĴ */
+    byte = spi1_exchange(0Xff);  /* ȡһֽ */
     NORFLASH_CS(1);
     
     return byte;
@@ -198,8 +249,8 @@ void norflash_write_sr(uint8_t regno, uint8_t sr)
     }
 
     NORFLASH_CS(0);
-    spi1_read_write_byte(command);  /* ͶĴ */
-    spi1_read_write_byte(sr);       /* дһֽ */
+    spi1_exchange(command);  /* ͶĴ */
+    spi1_exchange(sr);       /* дһֽ */
     NORFLASH_CS(1);
 }
 
@@ -214,17 +265,43 @@ uint16_t norflash_read_id(void)
     uint16_t deviceid;
 
     NORFLASH_CS(0);
-    spi1_read_write_byte(FLASH_ManufactDeviceID);   /* Ͷ ID  */
-    spi1_read_write_byte(0);    /* дһֽ */
-    spi1_read_write_byte(0);
-    spi1_read_write_byte(0);
-    deviceid = spi1_read_write_byte(0xFF) << 8;     /* ȡ8λֽ */
-    deviceid |= spi1_read_write_byte(0xFF);         /* ȡ8λֽ */
+    spi1_exchange(FLASH_ManufactDeviceID);   /* Ͷ ID  */
+    spi1_exchange(0);    /* дһֽ */
+    spi1_exchange(0);
+    spi1_exchange(0);
+    deviceid = spi1_exchange(0xFF) << 8;     /* ȡ8λֽ */
+    deviceid |= spi1_exchange(0xFF);         /* ȡ8λֽ */
     NORFLASH_CS(1);
 
     return deviceid;
 }
 
+/**
+ * @brief       оƬ
+ *   @note      ֪оƬ豸 ID ֽΪָ (0X16: 8M ֽ = 2^23)
+ * @param       
+ * @retval      (ֽ), δ֪оƬ 0
+ */
+uint32_t norflash_capacity(void)
+{
+    switch (g_norflash_type)
+    {
+        case W25Q16:
+        case W25Q32:
+        case W25Q64:
+        case W25Q128:
+        case W25Q256:
+        case BY25Q64:
+        case BY25Q128:
+        case NM25Q64:
+        case NM25Q128:
+            return 1UL << ((g_norflash_type & 0XFF) + 1);
+
+        default:
+            return 0;
+    }
+}
+
 /**
  * @brief       ȡSPI FLASH
  *   @note      ַָʼȡָȵ
@@ -235,17 +312,15 @@ uint16_t norflash_read_id(void)
  */
 void norflash_read(uint8_t *pbuf, uint32_t addr, uint16_t datalen)
 {
-    uint16_t i;
-
+    norflash_async_sync();
     NORFLASH_CS(0);
-    spi1_read_write_byte(FLASH_ReadData);       /* Ͷȡ */
+    spi1_exchange(g_norflash_read_cmd);         /* Ͷȡ */
     norflash_send_address(addr);                /* ͵ַ */
-    
-    for(i=0;i<datalen;i++)
+    if (g_norflash_read_cmd == FLASH_FastReadData)
     {
-        pbuf[i] = spi1_read_write_byte(0XFF);   /* ѭȡ */
+        spi1_exchange(0XFF);                    /* ٶ: ַ8ʱ */
     }
-    
+    spi1_read_dma(pbuf, datalen);               /* ݶ DMA ȡ */
     NORFLASH_CS(1);
 }
 
@@ -259,21 +334,47 @@ void norflash_read(uint8_t *pbuf, uint32_t addr, uint16_t datalen)
  */
 static void norflash_write_page(uint8_t *pbuf, uint32_t addr, uint16_t datalen)
 {
-    uint16_t i;
+    if (norflash_program_start(pbuf, addr, datalen))
+    {
+        norflash_wait_busy();   /* ȴд */
+    }
+}
+
+/**
+ * @brief       һҳָ, ȴ
+ * @param       pbuf    : ݴ洢
+ * @param       addr    : ʼдĵַ(32bit)
+ * @param       datalen : Ҫдֽ(256),Ӧóҳʣֽ!!!
+ * @retval      1, ѷָ; 0, ϡдʱȫ0XFF, ûзָ
+ */
+static uint8_t norflash_program_start(uint8_t *pbuf, uint32_t addr, uint16_t datalen)
+{
+#if NORFLASH_SPARSE
+    while (datalen && pbuf[0] == 0XFF)      /* ȥͷ0XFF (̬Ҫ) */
+    {
+        pbuf++;
+        addr++;
+        datalen--;
+    }
+    while (datalen && pbuf[datalen - 1] == 0XFF)    /* ȥβ0XFF */
+    {
+        datalen--;
+    }
+    if (datalen == 0)
+    {
+        return 0;   /* ȫ0XFF, ҳ */
+    }
+#endif
+    g_norflash_programmed += datalen;
 
     norflash_write_enable();    /* дʹ */
 
     NORFLASH_CS(0);
-    spi1_read_write_byte(FLASH_PageProgram);    /* дҳ */
+    spi1_exchange(FLASH_PageProgram);    /* дҳ */
     norflash_send_address(addr);                /* ͵ַ */
-
-    for(i=0;i<datalen;i++)
-    {
-        spi1_read_write_byte(pbuf[i]);          /* ѭд */
-    }
-    
+    spi1_write_dma(pbuf, datalen);              /* ݶ DMA  */
     NORFLASH_CS(1);
-    norflash_wait_busy();       /* ȴд */
+    return 1;
 }
 
 /**
@@ -287,9 +388,11 @@ static void norflash_write_page(uint8_t *pbuf, uint32_t addr, uint16_t datalen)
  * @param       datalen : Ҫдֽ(65535)
  * @retval      
  */
-static void norflash_write_nocheck(uint8_t *pbuf, uint32_t addr, uint16_t datalen)
+void norflash_write_nocheck(uint8_t *pbuf, uint32_t addr, uint16_t datalen)
 {
     uint16_t pageremain;
+
+    norflash_async_sync();
     pageremain = 256 - addr % 256;  /* ҳʣֽ */
 
     if (datalen <= pageremain)      /* 256ֽ */
@@ -337,10 +440,6 @@ static void norflash_write_nocheck(uint8_t *pbuf, uint32_t addr, uint16_t datale
  * @param       datalen : Ҫдֽ(65535)
  * @retval      
  */
-#ifndef MEM1_ALLOC_TABLE_SIZE   /* ûж MEM1_ALLOC_TABLE_SIZE ˵ûõڴ */
-uint8_t g_norflash_buf[4096];   /*  */
-#endif 
-
 void norflash_write(uint8_t *pbuf, uint32_t addr, uint16_t datalen)
 {
     uint32_t secpos;
@@ -349,6 +448,8 @@ void norflash_write(uint8_t *pbuf, uint32_t addr, uint16_t datalen)
     uint16_t i;
     uint8_t *norflash_buf;
     
+    norflash_async_sync();
+
 #ifdef MEM1_ALLOC_TABLE_SIZE
     norflash_buf = mymalloc(SRAMIN, 4096);  /* ʹڴ ڴ */
     if(norflash_buf == NULL)
@@ -356,7 +457,11 @@ void norflash_write(uint8_t *pbuf, uint32_t addr, uint16_t datalen)
         return;                     /* ʧ, ֱ˳ */
     }
 #else
-    norflash_buf = g_norflash_buf;  /* ʹڴ, ֱָ g_norflash_buf  */
+    norflash_buf = scratch_borrow(SCRATCH_NORFLASH, 4096);  /* ʹڴ, ӹ */
+    if(norflash_buf == NULL)
+    {
+        return;                     /* ʧ, ֱ˳ */
+    }
 #endif
 
     secpos = addr / 4096;       /* ַ */
@@ -371,30 +476,38 @@ void norflash_write(uint8_t *pbuf, uint32_t addr, uint16_t datalen)
 
     while (1)
     {
-        norflash_read(norflash_buf, secpos * 4096, 4096);   /*  */
-
-        for (i = 0; i < secremain; i++)   /* У */
+        if (secremain == 4096)  /* , Ҫԭ */
         {
-            if (norflash_buf[secoff + i] != 0XFF)
-            {
-                break;      /* Ҫ, ֱ˳forѭ */
-            }
+            norflash_erase_sector(secpos);
+            norflash_write_nocheck(pbuf, secpos * 4096, 4096);
         }
-
-        if (i < secremain)   /* Ҫ */
+        else
         {
-            norflash_erase_sector(secpos);  /*  */
+            norflash_read(norflash_buf, secpos * 4096, 4096);   /*  */
 
-            for (i = 0; i < secremain; i++)   /*  */
+            for (i = 0; i < secremain; i++)   /* У */
             {
-                norflash_buf[i + secoff] = pbuf[i];
+                if (norflash_buf[secoff + i] != 0XFF)
+                {
+                    break;      /* Ҫ, ֱ˳forѭ */
+                }
             }
 
-            norflash_write_nocheck(norflash_buf, secpos * 4096, 4096);  /* д */
-        }
-        else        /* дѾ˵,ֱдʣ. */
-        {
-            norflash_write_nocheck(pbuf, addr, secremain);  /* ֱд */
+            if (i < secremain)   /* Ҫ */
+            {
+                norflash_erase_sector(secpos);  /*  */
+
+                for (i = 0; i < secremain; i++)   /*  */
+                {
+                    norflash_buf[i + secoff] = pbuf[i];
+                }
+
+                norflash_write_nocheck(norflash_buf, secpos * 4096, 4096);  /* д */
+            }
+            else        /* дѾ˵,ֱдʣ. */
+            {
+                norflash_write_nocheck(pbuf, addr, secremain);  /* ֱд */
+            }
         }
 
         if (datalen == secremain)
@@ -422,9 +535,212 @@ void norflash_write(uint8_t *pbuf, uint32_t addr, uint16_t datalen)
     }
 #ifdef MEM1_ALLOC_TABLE_SIZE        /* ʹڴ */
     myfree(SRAMIN, norflash_buf);   /* ͷڴ */
+#else
+    scratch_return(SCRATCH_NORFLASH);   /* 黹 */
 #endif
 }
 
+/**
+ * @brief       һ
+ *   @note       4K չ߽, Ȼӵ͵ַʼ: 64K ʣ಻ 64K ʱ
+ *              ÿ(0xD8), 32K ʣ಻ 32K ʱð(0x52), .
+ *              һο 16 ö.
+ * @param       addr : ʼֽڵַ
+ * @param       len  : ֽ
+ * @retval      
+ */
+void norflash_erase_range(uint32_t addr, uint32_t len)
+{
+    uint32_t end = (addr + len + 4095) & ~4095UL;
+
+    norflash_async_sync();
+    addr &= ~4095UL;
+    while (addr < end)
+    {
+        addr += norflash_erase_start(addr, end);
+        norflash_wait_busy();           /* ȴ */
+    }
+}
+
+/**
+ * @brief       ƻһָ, ȴ
+ * @param       addr : ʼַ (4K )
+ * @param       end  : ַ (4K )
+ * @retval      ָֽ
+ */
+static uint32_t norflash_erase_start(uint32_t addr, uint32_t end)
+{
+    uint32_t size;
+    uint8_t command;
+
+    if ((addr % 65536 == 0) && (end - addr >= 65536))
+    {
+        command = FLASH_BlockErase;
+        size = 65536;
+    }
+    else if ((addr % 32768 == 0) && (end - addr >= 32768))
+    {
+        command = FLASH_Block32Erase;
+        size = 32768;
+    }
+    else
+    {
+        command = FLASH_SectorErase;
+        size = 4096;
+    }
+
+    norflash_write_enable();        /* дʹ */
+    NORFLASH_CS(0);
+    spi1_exchange(command);
+    norflash_send_address(addr);
+    NORFLASH_CS(1);
+    return size;
+}
+
+/******************************************************************************************/
+/* 첽д: ŶӺ norflash_async_poll ƽ, ÿֻѯһ BUSY, ȴ */
+
+/**
+ * @brief       Ŷһ
+ * @retval      0, ɹ; 1, 
+ */
+static uint8_t norflash_async_push(uint8_t type, uint8_t *pbuf, uint32_t addr, uint32_t end, norflash_cb cb)
+{
+    norflash_op *op;
+
+    if (g_norflash_async.count >= NORFLASH_ASYNC_NUM)
+    {
+        return 1;
+    }
+    op = &g_norflash_async.op[(g_norflash_async.head + g_norflash_async.count) % NORFLASH_ASYNC_NUM];
+    op->type = type;
+    op->pbuf = pbuf;
+    op->addr = addr;
+    op->end = end;
+    op->cb = cb;
+    g_norflash_async.count++;
+    norflash_async_poll();      /* оƬʱһָ */
+    return 0;
+}
+
+/**
+ * @brief       첽һ ( norflash_erase_range Ĳƻ)
+ * @param       addr : ʼֽڵַ
+ * @param       len  : ֽ
+ * @param       cb   : ɻص,  norflash_async_poll е, ΪNULL
+ * @retval      0, Ŷ; 1, 
+ */
+uint8_t norflash_async_erase(uint32_t addr, uint32_t len, norflash_cb cb)
+{
+    return norflash_async_push(NORFLASH_OP_ERASE, NULL, addr & ~4095UL, (addr + len + 4095) & ~4095UL, cb);
+}
+
+/**
+ * @brief       첽д (޼, ĿѲ)
+ *   @note      ɻص֮ǰ pbuf еݱ뱣ֲ
+ * @param       pbuf    : ݴ洢
+ * @param       addr    : ʼдĵַ
+ * @param       datalen : Ҫдֽ
+ * @param       cb      : ɻص, ΪNULL
+ * @retval      0, Ŷ; 1, 
+ */
+uint8_t norflash_async_program(uint8_t *pbuf, uint32_t addr, uint16_t datalen, norflash_cb cb)
+{
+    return norflash_async_push(NORFLASH_OP_PROGRAM, pbuf, addr, addr + datalen, cb);
+}
+
+/**
+ * @brief       ƽ첽
+ *   @note      ѭʱе: оƬæʱֻһ״̬Ĵͷ,
+ *              ʱǰһ/ҳָ, ʱص.
+ * @param       
+ * @retval      
+ */
+void norflash_async_poll(void)
+{
+    norflash_op *op;
+    norflash_cb cb;
+    uint16_t n;
+
+    while (g_norflash_async.count)
+    {
+        if (g_norflash_async.running)
+        {
+            if (norflash_read_sr(1) & 0x01)
+            {
+                return;     /* оƬæ */
+            }
+            g_norflash_async.running = 0;
+        }
+
+        op = &g_norflash_async.op[g_norflash_async.head];
+        if (op->addr >= op->end)    /* ǰ */
+        {
+            cb = op->cb;
+            g_norflash_async.head = (g_norflash_async.head + 1) % NORFLASH_ASYNC_NUM;
+            g_norflash_async.count--;
+            if (cb != NULL)
+            {
+                cb();
+            }
+            continue;
+        }
+
+        if (op->type == NORFLASH_OP_ERASE)
+        {
+            op->addr += norflash_erase_start(op->addr, op->end);
+            g_norflash_async.running = 1;
+        }
+        else
+        {
+            n = 256 - op->addr % 256;   /* ҳ */
+            if (n > op->end - op->addr)
+            {
+                n = op->end - op->addr;
+            }
+            g_norflash_async.running = norflash_program_start(op->pbuf, op->addr, n);
+            op->pbuf += n;
+            op->addr += n;
+        }
+    }
+}
+
+/**
+ * @brief       Ƿδɵ첽
+ * @retval      1, ; 0, ȫ
+ */
+uint8_t norflash_async_busy(void)
+{
+    return g_norflash_async.count != 0;
+}
+
+/**
+ * @brief       ȴȫ첽
+ *   @note      ͬӿڷоƬǰ, ֤첽
+ * @param       
+ * @retval      
+ */
+static void norflash_async_sync(void)
+{
+    while (g_norflash_async.count)
+    {
+        norflash_async_poll();
+    }
+}
+
+/**
+ * @brief       ȡʵʱ̵ֽ
+ * @param       
+ * @retval      ϴʵʱ̵ֽ
+ */
+uint32_t norflash_programmed(void)
+{
+    uint32_t bytes = g_norflash_programmed;
+
+    g_norflash_programmed = 0;
+    return bytes;
+}
+
 /**
  * @brief       оƬ
  *   @note      ȴʱ䳬...
@@ -433,10 +749,11 @@ void norflash_write(uint8_t *pbuf, uint32_t addr, uint16_t datalen)
  */
 void norflash_erase_chip(void)
 {
+    norflash_async_sync();
     norflash_write_enable();    /* дʹ */
     norflash_wait_busy();       /* ȴ */
     NORFLASH_CS(0);
-    spi1_read_write_byte(FLASH_ChipErase);  /* ͶĴ */ 
+    spi1_exchange(FLASH_ChipErase);  /* ͶĴ */ 
     NORFLASH_CS(1);
     norflash_wait_busy();       /* ȴоƬ */
 }
@@ -453,11 +770,12 @@ void norflash_erase_sector(uint32_t saddr)
 {
     //printf("fe:%x\r\n", saddr);   /* falsh, */
     saddr *= 4096;
+    norflash_async_sync();
     norflash_write_enable();        /* дʹ */
     norflash_wait_busy();           /* ȴ */
 
     NORFLASH_CS(0);
-    spi1_read_write_byte(FLASH_SectorErase);    /* дҳ */
+    spi1_exchange(FLASH_SectorErase);    /* дҳ */
     norflash_send_address(saddr);   /* ͵ַ */
     NORFLASH_CS(1);
     norflash_wait_busy();           /* ȴ */
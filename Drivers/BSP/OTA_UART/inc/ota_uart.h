@@ -11,11 +11,17 @@
 #define OTA_UART_H
 
 #include "main.h"
+#include "spsc_queue.h"
 
 // 串口缓冲区相关定义
-#define OTA_RX_SIZE 2048
-#define OTA_RX_MAX 256
-#define NUM 10
+#define OTA_RX_SIZE 6144 // 循环 DMA 接收缓冲区大小，需容纳流式传输一个完整窗口 (4帧)
+#define OTA_RX_MAX 1040  // 单帧最大长度，需大于 Xmodem-1K 数据包 (1029字节)，也是回绕帧拼接区大小
+#define OTA_RX_FRAMES 16 // 帧队列容量 (2的幂)
+
+// 串口发送缓冲区相关定义
+#define OTA_TX_SIZE 1024  // 日志发送环形缓冲区大小 (2的幂)
+#define OTA_TX_URGENT 64  // 协议应答发送缓冲区大小，优先于日志发送
+#define OTA_TX_CHUNK 64   // 单次 DMA 发送日志的最大字节数，限制协议应答排在日志之后的等待时间
 
 // 外设底层定义
 #define OTA_UART_CLK_ENABLE() __HAL_RCC_USART1_CLK_ENABLE()
@@ -34,6 +40,11 @@
 
 #define OTA_UART_DMA DMA1_Channel5
 #define OTA_UART_DMA_IRQn DMA1_Channel5_IRQn
+#define OTA_UART_DMA_IRQHandler DMA1_Channel5_IRQHandler
+
+#define OTA_UART_TX_DMA DMA1_Channel4
+#define OTA_UART_TX_DMA_IRQn DMA1_Channel4_IRQn
+#define OTA_UART_TX_DMA_IRQHandler DMA1_Channel4_IRQHandler
 
 /**
  * @brief 缓冲区管理块指针对
@@ -45,21 +56,49 @@ typedef struct{
 
 /**
  * @brief 缓冲区管理结构体
+ * @details 接收中断把帧的位置放入 URxQueue，主循环按序取出。队列满时丢弃新帧并计数，
+ *          不会覆盖主循环尚未处理的帧。
 */
 typedef struct
 {
-    uint16_t URxcounter;
-    UCB_URXBuffptr URxDataPtr[NUM];
-    UCB_URXBuffptr *URxDataIN;
-    UCB_URXBuffptr *URxDataOUT;
-    UCB_URXBuffptr *URxDataEND;
+    uint16_t URxcounter; // 上一个帧边界在循环缓冲区中的位置
+    UCB_URXBuffptr URxDataPtr[OTA_RX_FRAMES]; // 帧队列存储区
+    spsc_queue URxQueue; // 帧队列 (接收中断 -> 主循环)
 }UCB_CB; 
 
-extern volatile UCB_CB ota_uart_cb;                      // 接收控制块（管理接收逻辑的核心结构体）
-extern volatile uint8_t ota_rxbuff[OTA_RX_SIZE];         // 物理接收缓冲区
+/**
+ * @brief 发送管理结构体
+ * @details 日志 (printf) 写入环形缓冲区，协议应答写入单独的应答缓冲区。DMA 空闲时
+ *          优先发送应答，日志每次最多发送 OTA_TX_CHUNK 字节，应答不会排在大量日志之后。
+*/
+typedef struct
+{
+    uint8_t buff[OTA_TX_SIZE];     // 日志环形缓冲区
+    volatile uint16_t head;        // 日志写入位置 (自由计数，取模使用)
+    volatile uint16_t tail;        // 日志发送位置
+    uint8_t urgent[OTA_TX_URGENT]; // 协议应答缓冲区
+    volatile uint16_t urgent_len;  // 协议应答字节数
+    volatile uint16_t busy;        // DMA 正在发送的字节数，0 表示空闲
+    volatile uint8_t busy_urgent;  // DMA 正在发送的是协议应答
+}UCB_TX;
+
+extern UCB_CB ota_uart_cb;                      // 接收控制块（管理接收逻辑的核心结构体）
+extern volatile uint8_t ota_rxbuff[OTA_RX_SIZE + OTA_RX_MAX]; // 物理接收缓冲区 (循环 DMA 区 + 回绕帧拼接区)
 
 // 外部接口函数
 void ota_uart_init(uint32_t bandrate);
+void ota_uart_deinit(void);
 void ota_uart_cb_init(void);
+UCB_URXBuffptr *ota_uart_rx_peek(void);
+uint8_t *ota_uart_rx_join(uint8_t *start, uint16_t len);
+void ota_uart_rx_pop(void);
+uint8_t ota_uart_rx_pending(void);
+void ota_uart_send(uint8_t *data, uint16_t len);
+void ota_uart_send_byte(uint8_t byte);
+void ota_uart_write(uint8_t *data, uint16_t len);
+void ota_uart_flush(void);
+uint8_t ota_uart_baud_check(uint32_t baud);
+void ota_uart_set_baud(uint32_t baud);
+uint32_t ota_uart_get_baud(void);
 
 #endif // !OTA_UART_H
\ No newline at end of file
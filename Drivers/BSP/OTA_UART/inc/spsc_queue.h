@@ -0,0 +1,36 @@
+/**
+ * @file spsc_queue.h
+ * @brief 单生产者/单消费者无锁队列
+ *
+ * 用于中断 (生产者) 向主循环 (消费者) 传递定长元素。容量为 2 的幂，读写计数
+ * 自由增长、按掩码取下标，head - tail 即占用数，所有槽位都可使用。队列满时
+ * 新元素被丢弃并计数，不会覆盖尚未取出的元素。
+ */
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include "main.h"
+
+/**
+ * @brief 队列控制块
+ */
+typedef struct
+{
+    uint8_t *buf;                // 元素存储区
+    uint16_t size;               // 元素大小 (字节)
+    uint16_t mask;               // 容量 - 1
+    volatile uint16_t head;      // 写入计数，只由生产者修改
+    volatile uint16_t tail;      // 读取计数，只由消费者修改
+    volatile uint32_t dropped;   // 队列满丢弃的元素数
+    volatile uint16_t highwater; // 占用数最大值
+}spsc_queue;
+
+void spsc_init(spsc_queue *q, void *buf, uint16_t size, uint16_t num);
+uint8_t spsc_push(spsc_queue *q, const void *item);
+void *spsc_peek(spsc_queue *q);
+void spsc_pop(spsc_queue *q);
+uint16_t spsc_count(spsc_queue *q);
+uint8_t spsc_empty(spsc_queue *q);
+uint8_t spsc_full(spsc_queue *q);
+
+#endif // !SPSC_QUEUE_H
@@ -2,12 +2,23 @@
 #include <stddef.h>
 // --- 全局变量定义 ---
 DMA_HandleTypeDef g_ota_uart_dma_handle; // DMA句柄
+DMA_HandleTypeDef g_ota_uart_txdma_handle; // 发送DMA句柄
 UART_HandleTypeDef g_ota_uart_handle;    // UART句柄
-volatile UCB_CB ota_uart_cb;                      // 接收控制块（管理接收逻辑的核心结构体）
-volatile uint8_t ota_rxbuff[OTA_RX_SIZE];         // 物理接收缓冲区 (假设 OTA_RX_SIZE 为 2048)
+UCB_CB ota_uart_cb;                               // 接收控制块（管理接收逻辑的核心结构体）
+volatile uint8_t ota_rxbuff[OTA_RX_SIZE + OTA_RX_MAX]; // 物理接收缓冲区 (循环 DMA 区 + 回绕帧拼接区)
+static UCB_TX ota_uart_tx;                        // 发送控制块
+
+static void ota_uart_tx_kick(void);
+static void ota_uart_tx_done(DMA_HandleTypeDef *hdma);
+static void ota_uart_rx_event(uint8_t idle);
+static void ota_uart_rx_half(DMA_HandleTypeDef *hdma);
+static void ota_uart_rx_full(DMA_HandleTypeDef *hdma);
+static void ota_uart_rx_push(uint16_t pos, uint16_t len);
+static void ota_uart_rx_linear(UCB_URXBuffptr *frame);
 
 /**
  * @brief printf串口重定向
+ * @details 写入日志发送缓冲区后立即返回，由 DMA 在后台发送。
  * @param  fd 
  * @param  ptr
  * @param  len
@@ -15,11 +26,199 @@ volatile uint8_t ota_rxbuff[OTA_RX_SIZE];         // 物理接收缓冲区 (假
 */
 int _write(int fd, char *ptr, int len)  
 {  
-  HAL_UART_Transmit(&g_ota_uart_handle, (uint8_t*)ptr, len, 0xFFFF);
+  ota_uart_write((uint8_t *)ptr, len);
   return len;
   
 }
 
+/**
+ * @brief 串口发送原始数据 (二进制安全，用于协议应答帧)
+ * @details 写入协议应答缓冲区，DMA 空闲时优先于日志发送。缓冲区满时等待。
+ * @param  data 数据
+ * @param  len  长度
+ */
+void ota_uart_send(uint8_t *data, uint16_t len)
+{
+    uint32_t primask;
+    uint16_t count;
+
+    while (len) {
+        primask = __get_PRIMASK();
+        __disable_irq();
+        count = OTA_TX_URGENT - ota_uart_tx.urgent_len;
+        if (count > len) {
+            count = len;
+        }
+        memcpy(&ota_uart_tx.urgent[ota_uart_tx.urgent_len], data, count);
+        ota_uart_tx.urgent_len += count;
+        ota_uart_tx_kick();
+        __set_PRIMASK(primask);
+
+        data += count;
+        len -= count;
+    }
+}
+
+/**
+ * @brief 串口发送单字节协议应答 (ACK/NAK/CAN/'C')
+ * @param  byte 应答字节
+ */
+void ota_uart_send_byte(uint8_t byte)
+{
+    ota_uart_send(&byte, 1);
+}
+
+/**
+ * @brief 串口发送日志数据
+ * @details 写入日志环形缓冲区，缓冲区满时等待 DMA 发出一部分后继续写入。
+ * @param  data 数据
+ * @param  len  长度
+ */
+void ota_uart_write(uint8_t *data, uint16_t len)
+{
+    uint32_t primask;
+    uint16_t space;
+
+    while (len) {
+        space = OTA_TX_SIZE - (uint16_t)(ota_uart_tx.head - ota_uart_tx.tail);
+        if (space == 0) {
+            continue;
+        }
+        if (space > len) {
+            space = len;
+        }
+        len -= space;
+        while (space--) {
+            ota_uart_tx.buff[ota_uart_tx.head & (OTA_TX_SIZE - 1)] = *data++;
+            ota_uart_tx.head++;
+        }
+
+        primask = __get_PRIMASK();
+        __disable_irq();
+        ota_uart_tx_kick();
+        __set_PRIMASK(primask);
+    }
+}
+
+/**
+ * @brief 等待发送缓冲区中的数据全部发出
+ * @details 修改波特率、复位或跳转 APP 之前调用。
+ */
+void ota_uart_flush(void)
+{
+    while (ota_uart_tx.busy || ota_uart_tx.urgent_len || (ota_uart_tx.head != ota_uart_tx.tail));
+    while (__HAL_UART_GET_FLAG(&g_ota_uart_handle, UART_FLAG_TC) == RESET);
+}
+
+/**
+ * @brief 启动一次 DMA 发送 (需在关中断或 DMA 中断中调用)
+ * @details DMA 空闲时先发送全部协议应答，没有应答时发送一段连续的日志。
+ */
+static void ota_uart_tx_kick(void)
+{
+    uint16_t idx;
+    uint16_t count;
+
+    if (ota_uart_tx.busy) {
+        return;
+    }
+    if (ota_uart_tx.urgent_len) {
+        ota_uart_tx.busy = ota_uart_tx.urgent_len;
+        ota_uart_tx.busy_urgent = 1;
+        HAL_DMA_Start_IT(&g_ota_uart_txdma_handle, (uint32_t)ota_uart_tx.urgent, (uint32_t)&OTA_UART->DR, ota_uart_tx.busy);
+    }
+    else if (ota_uart_tx.head != ota_uart_tx.tail) {
+        idx = ota_uart_tx.tail & (OTA_TX_SIZE - 1);
+        count = ota_uart_tx.head - ota_uart_tx.tail;
+        if (count > OTA_TX_SIZE - idx) {
+            count = OTA_TX_SIZE - idx; // 不跨越缓冲区末尾
+        }
+        if (count > OTA_TX_CHUNK) {
+            count = OTA_TX_CHUNK;
+        }
+        ota_uart_tx.busy = count;
+        ota_uart_tx.busy_urgent = 0;
+        HAL_DMA_Start_IT(&g_ota_uart_txdma_handle, (uint32_t)&ota_uart_tx.buff[idx], (uint32_t)&OTA_UART->DR, count);
+    }
+}
+
+/**
+ * @brief 发送 DMA 完成回调
+ * @details 移除已发出的数据，继续发送下一段。发送期间追加的协议应答移到缓冲区开头。
+ * @param hdma DMA句柄
+ */
+static void ota_uart_tx_done(DMA_HandleTypeDef *hdma)
+{
+    if (ota_uart_tx.busy_urgent) {
+        ota_uart_tx.urgent_len -= ota_uart_tx.busy;
+        memmove(ota_uart_tx.urgent, &ota_uart_tx.urgent[ota_uart_tx.busy], ota_uart_tx.urgent_len);
+    }
+    else {
+        ota_uart_tx.tail += ota_uart_tx.busy;
+    }
+    ota_uart_tx.busy = 0;
+    ota_uart_tx_kick();
+}
+
+/**
+ * @brief 发送 DMA 中断服务函数
+ */
+void OTA_UART_TX_DMA_IRQHandler(void)
+{
+    HAL_DMA_IRQHandler(&g_ota_uart_txdma_handle);
+}
+
+/**
+ * @brief 检查波特率是否可用
+ * @details BRR 以 1/16 为单位分频，分频后的实际波特率误差需小于 2%。
+ * @param  baud 波特率
+ * @return uint8_t 1:可用 0:不可用
+ */
+uint8_t ota_uart_baud_check(uint32_t baud)
+{
+    uint32_t pclk = HAL_RCC_GetPCLK2Freq();
+    uint32_t brr;
+    uint32_t actual;
+
+    if ((baud < 1200) || (baud > pclk / 16)) {
+        return 0;
+    }
+    brr = (pclk + baud / 2) / baud;
+    actual = pclk / brr;
+    return ((actual > baud) ? (actual - baud) : (baud - actual)) * 50 < baud;
+}
+
+/**
+ * @brief 运行中修改波特率
+ * @details 等待发送缓冲区发完后关闭串口，重新写入 BRR 再打开。循环 DMA 接收不停止，
+ *          切换期间线路上的数据会丢失，由上层协议确认新波特率可用。
+ * @param baud 波特率
+ */
+void ota_uart_set_baud(uint32_t baud)
+{
+    ota_uart_flush();
+
+    HAL_NVIC_DisableIRQ(OTA_UART_IRQn);
+
+    __HAL_UART_DISABLE(&g_ota_uart_handle);
+    g_ota_uart_handle.Init.BaudRate = baud;
+    OTA_UART->BRR = UART_BRR_SAMPLING16(HAL_RCC_GetPCLK2Freq(), baud);
+    __HAL_UART_ENABLE(&g_ota_uart_handle);
+
+    // 清除切换过程中产生的帧错误/溢出与空闲标志
+    __HAL_UART_CLEAR_PEFLAG(&g_ota_uart_handle);
+    HAL_NVIC_EnableIRQ(OTA_UART_IRQn);
+}
+
+/**
+ * @brief 当前波特率
+ * @return uint32_t 波特率
+ */
+uint32_t ota_uart_get_baud(void)
+{
+    return g_ota_uart_handle.Init.BaudRate;
+}
+
 /**
  * @brief 串口硬件初始化
  * @param bandrate 波特率
@@ -47,8 +246,13 @@ void ota_uart_init(uint32_t bandrate)
 
     // 3. NVIC 中断控制器配置
     // 配置串口中断优先级并使能
+    // 接收 DMA 与串口空闲中断同一优先级，互不抢占，帧切分不需要额外保护
     HAL_NVIC_SetPriority(OTA_UART_IRQn, 2,  0);
     HAL_NVIC_EnableIRQ(OTA_UART_IRQn);
+    HAL_NVIC_SetPriority(OTA_UART_DMA_IRQn, 2,  0);
+    HAL_NVIC_EnableIRQ(OTA_UART_DMA_IRQn);
+    HAL_NVIC_SetPriority(OTA_UART_TX_DMA_IRQn, 3,  0);
+    HAL_NVIC_EnableIRQ(OTA_UART_TX_DMA_IRQn);
     
 
     // 4. 串口参数初始化
@@ -71,76 +275,219 @@ void ota_uart_init(uint32_t bandrate)
     g_ota_uart_dma_handle.Init.MemInc = DMA_MINC_ENABLE;         // 内存地址自增
     g_ota_uart_dma_handle.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
     g_ota_uart_dma_handle.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
-    g_ota_uart_dma_handle.Init.Mode = DMA_NORMAL;                // 普通模式 (非循环，需手动重置)
+    g_ota_uart_dma_handle.Init.Mode = DMA_CIRCULAR;              // 循环模式 (一直运行，不再每帧重启)
     g_ota_uart_dma_handle.Init.Priority = DMA_PRIORITY_MEDIUM;
     HAL_DMA_Init(&g_ota_uart_dma_handle);
+    g_ota_uart_dma_handle.XferHalfCpltCallback = ota_uart_rx_half;
+    g_ota_uart_dma_handle.XferCpltCallback = ota_uart_rx_full;
     
-    // 关联 UART 句柄和 DMA 句柄
-    __HAL_LINKDMA(&g_ota_uart_handle, hdmarx, g_ota_uart_dma_handle);
-    
-    // 6. 开启首次 DMA 接收
-    HAL_UART_Receive_DMA(&g_ota_uart_handle,  (uint8_t *)ota_rxbuff, OTA_RX_MAX + 1);
+    // 6. 发送 DMA 初始化：内存->串口DR，由发送控制块逐段启动
+    g_ota_uart_txdma_handle.Instance = OTA_UART_TX_DMA;
+    g_ota_uart_txdma_handle.Init.Direction = DMA_MEMORY_TO_PERIPH;
+    g_ota_uart_txdma_handle.Init.PeriphInc = DMA_PINC_DISABLE;
+    g_ota_uart_txdma_handle.Init.MemInc = DMA_MINC_ENABLE;
+    g_ota_uart_txdma_handle.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    g_ota_uart_txdma_handle.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    g_ota_uart_txdma_handle.Init.Mode = DMA_NORMAL;
+    g_ota_uart_txdma_handle.Init.Priority = DMA_PRIORITY_LOW;
+    HAL_DMA_Init(&g_ota_uart_txdma_handle);
+    g_ota_uart_txdma_handle.XferCpltCallback = ota_uart_tx_done;
+    SET_BIT(OTA_UART->CR3, USART_CR3_DMAT); // 串口发送请求交给 DMA
+
+    // 7. 开启循环 DMA 接收，之后不再停止
+    HAL_DMA_Start_IT(&g_ota_uart_dma_handle, (uint32_t)&OTA_UART->DR, (uint32_t)ota_rxbuff, OTA_RX_SIZE);
+    SET_BIT(OTA_UART->CR3, USART_CR3_DMAR);
+}
+
+/**
+ * @brief 关闭串口与收发 DMA
+ * @details 跳转 APP 之前调用 (先调用 ota_uart_flush 发完日志)：停止循环 DMA 接收
+ *          (否则 DMA 会继续写入已属于 APP 的 ota_rxbuff 地址) 与发送 DMA，关闭串口、
+ *          接收/发送 DMA 中断并清除挂起，复位串口。
+ *          接收 DMA 由 HAL_DMA_Start_IT 直接启动，没有经过 UART 句柄，
+ *          因此直接清除 DMAR 并停止通道，而不是 HAL_UART_DMAStop。
+ */
+void ota_uart_deinit(void)
+{
+    HAL_NVIC_DisableIRQ(OTA_UART_IRQn);
+    HAL_NVIC_DisableIRQ(OTA_UART_DMA_IRQn);
+    HAL_NVIC_DisableIRQ(OTA_UART_TX_DMA_IRQn);
+
+    CLEAR_BIT(OTA_UART->CR3, USART_CR3_DMAR | USART_CR3_DMAT);
+    HAL_DMA_Abort(&g_ota_uart_dma_handle);
+    HAL_DMA_DeInit(&g_ota_uart_dma_handle);
+    HAL_DMA_Abort(&g_ota_uart_txdma_handle);
+    HAL_DMA_DeInit(&g_ota_uart_txdma_handle);
+    HAL_UART_DeInit(&g_ota_uart_handle);
+
+    HAL_NVIC_ClearPendingIRQ(OTA_UART_IRQn);
+    HAL_NVIC_ClearPendingIRQ(OTA_UART_DMA_IRQn);
+    HAL_NVIC_ClearPendingIRQ(OTA_UART_TX_DMA_IRQn);
 }
 
 /**
  * @brief 接收管理控制块初始化
+ * @note  需在 ota_uart_init 之前调用，接收中断开启时帧队列已可用
  */
 void ota_uart_cb_init(void)
 {
-    // 初始化指针队列的头尾指针
-    ota_uart_cb.URxDataIN = (UCB_URXBuffptr *)&ota_uart_cb.URxDataPtr[0];    // 入队指针
-    ota_uart_cb.URxDataOUT = (UCB_URXBuffptr *)&ota_uart_cb.URxDataPtr[0];   // 出队指针（代码中未展示出队逻辑）
-    ota_uart_cb.URxDataEND = (UCB_URXBuffptr *)&ota_uart_cb.URxDataPtr[NUM - 1]; // 队列边界指针
-    
-        // 初始化数据存放的起始位置
-    ota_uart_cb.URxDataIN->start = (uint8_t *)ota_rxbuff;    
-    ota_uart_cb.URxcounter = 0; // 当前缓冲区的写偏移量
+    spsc_init(&ota_uart_cb.URxQueue, ota_uart_cb.URxDataPtr, sizeof(UCB_URXBuffptr), OTA_RX_FRAMES);
+    ota_uart_cb.URxcounter = 0; // 上一个帧边界在缓冲区中的位置
+}
+
+/**
+ * @brief 取出下一帧 (不移出队列，处理完后调用 ota_uart_rx_pop)
+ * @return UCB_URXBuffptr* 帧的起止位置，没有数据时为 NULL
+ */
+UCB_URXBuffptr *ota_uart_rx_peek(void)
+{
+    UCB_URXBuffptr *frame = spsc_peek(&ota_uart_cb.URxQueue);
+
+    if (frame != NULL) {
+        ota_uart_rx_linear(frame);
+    }
+    return frame;
+}
+
+/**
+ * @brief 移除已处理的帧
+ */
+void ota_uart_rx_pop(void)
+{
+    spsc_pop(&ota_uart_cb.URxQueue);
+}
+
+/**
+ * @brief 是否有待处理的帧
+ * @return uint8_t 1:有 0:没有
+ */
+uint8_t ota_uart_rx_pending(void)
+{
+    return !spsc_empty(&ota_uart_cb.URxQueue);
+}
+
+/**
+ * @brief 使回绕的帧在内存中连续
+ * @details 帧跨越循环缓冲区末尾时，end 指向缓冲区之后的拼接区，出队前把回绕到
+ *          缓冲区开头的部分复制到拼接区。在主循环中调用，中断里不做复制。
+ * @param frame 待处理的帧
+ */
+static void ota_uart_rx_linear(UCB_URXBuffptr *frame)
+{
+    if (frame->end >= &ota_rxbuff[OTA_RX_SIZE]) {
+        memcpy((uint8_t *)&ota_rxbuff[OTA_RX_SIZE], (uint8_t *)ota_rxbuff, frame->end - &ota_rxbuff[OTA_RX_SIZE] + 1);
+    }
+}
+
+/**
+ * @brief 使分在几次接收中的一段数据在内存中连续
+ * @details 相邻几次接收的数据在循环缓冲区中本来就是相邻的 (流式传输的帧可以分在几次
+ *          接收中)，只有跨越缓冲区末尾时需要把回绕到开头的部分复制到拼接区，与
+ *          ota_uart_rx_linear 相同。数据在 DMA 写满一圈之前保持有效。
+ * @param start 数据起始位置 (循环缓冲区或拼接区中)
+ * @param len   字节数，不超过 OTA_RX_MAX
+ * @return uint8_t* 连续数据的起始地址
+ */
+uint8_t *ota_uart_rx_join(uint8_t *start, uint16_t len)
+{
+    uint8_t *splice = (uint8_t *)&ota_rxbuff[OTA_RX_SIZE];
+
+    if (start >= splice) {
+        start -= OTA_RX_SIZE; // 拼接区是缓冲区开头的副本
+    }
+    if (start + len > splice) {
+        memcpy(splice, (uint8_t *)ota_rxbuff, start + len - splice);
+    }
+    return start;
+}
+
+/**
+ * @brief 帧入队
+ * @details 队列满时丢弃该帧 (计入 dropped)，主机超时后会重发。
+ * @param pos 帧在缓冲区中的起始位置
+ * @param len 帧长度
+ */
+static void ota_uart_rx_push(uint16_t pos, uint16_t len)
+{
+    UCB_URXBuffptr frame;
+
+    frame.start = (uint8_t *)&ota_rxbuff[pos];
+    frame.end = (uint8_t *)&ota_rxbuff[pos + len - 1];
+    spsc_push(&ota_uart_cb.URxQueue, &frame);
+}
+
+/**
+ * @brief 接收事件处理：由 DMA 剩余计数 (NDTR) 得到当前写入位置，切出新数据
+ * @details 空闲中断时，上一个边界到当前位置的数据作为一帧入队 (Xmodem 包、命令)。
+ *          半满/全满中断时，只有积累的数据不少于 OTA_RX_MAX (不可能是一个 Xmodem 包，
+ *          只能是连续发送的流式传输数据) 才切出，避免把 Xmodem 包切成两段。
+ *          超过 OTA_RX_MAX 的数据块跨越缓冲区末尾时拆成两块，不需要拼接；
+ *          较短的回绕帧由 ota_uart_rx_linear 在出队时拼接。
+ * @param idle 1:空闲中断 0:DMA 半满/全满中断
+ */
+static void ota_uart_rx_event(uint8_t idle)
+{
+    uint16_t pos;
+    uint16_t last = ota_uart_cb.URxcounter;
+    uint16_t len;
+
+    pos = OTA_RX_SIZE - __HAL_DMA_GET_COUNTER(&g_ota_uart_dma_handle);
+    if (pos == OTA_RX_SIZE) {
+        pos = 0;
+    }
+    len = (pos + OTA_RX_SIZE - last) % OTA_RX_SIZE;
+    if ((len == 0) || (!idle && (len < OTA_RX_MAX))) {
+        return;
+    }
+
+    if ((last + len > OTA_RX_SIZE) && (len > OTA_RX_MAX)) {
+        ota_uart_rx_push(last, OTA_RX_SIZE - last);
+        ota_uart_rx_push(0, pos);
+    }
+    else {
+        ota_uart_rx_push(last, len);
+    }
+    ota_uart_cb.URxcounter = pos;
+}
+
+/**
+ * @brief 接收 DMA 半满回调
+ * @param hdma DMA句柄
+ */
+static void ota_uart_rx_half(DMA_HandleTypeDef *hdma)
+{
+    ota_uart_rx_event(0);
+}
+
+/**
+ * @brief 接收 DMA 全满回调 (循环模式下写指针回到缓冲区开头)
+ * @param hdma DMA句柄
+ */
+static void ota_uart_rx_full(DMA_HandleTypeDef *hdma)
+{
+    ota_uart_rx_event(0);
+}
+
+/**
+ * @brief 接收 DMA 中断服务函数
+ */
+void OTA_UART_DMA_IRQHandler(void)
+{
+    HAL_DMA_IRQHandler(&g_ota_uart_dma_handle);
 }
 
 /**
  * @brief 串口中断服务函数
- * 核心逻辑：处理空闲中断，切分数据包
+ * 核心逻辑：处理空闲中断，按 DMA 当前位置切分数据包，DMA 不停止
  */
 void OTA_UART_IRQHandler(void)
 {
     // 检查是否是空闲中断 (IDLE Flag)
     if (__HAL_UART_GET_FLAG(&g_ota_uart_handle, UART_FLAG_IDLE) != RESET) {
         
-        // 1. 清除空闲中断标志位 (先读SR再读DR，HAL库宏封装了)
+        // 清除空闲中断标志位 (先读SR再读DR，HAL库宏封装了)
         __HAL_UART_CLEAR_IDLEFLAG(&g_ota_uart_handle);
-        
-        HAL_UART_DMAStop(&g_ota_uart_handle);
 
-        // 2. 计算当前接收到的数据位置
-        // 公式：当前偏移量 += (设定的DMA总长 - DMA剩余长度)
-        ota_uart_cb.URxcounter += (OTA_RX_MAX + 1) - __HAL_DMA_GET_COUNTER(&g_ota_uart_dma_handle);
-        
-        // 3. 记录当前数据包的结束地址
-        // end 指向的是本包数据的最后一个字节
-        ota_uart_cb.URxDataIN->end = (uint8_t *)&ota_rxbuff[ota_uart_cb.URxcounter - 1];
-        
-        // 4. 指针队列入队：移动 IN 指针到下一个槽位
-        ota_uart_cb.URxDataIN++;
-
-        // 5. 队列回绕处理 (Ring Buffer Logic for Metadata)
-        if (ota_uart_cb.URxDataIN == ota_uart_cb.URxDataEND) { 
-            ota_uart_cb.URxDataIN = (UCB_URXBuffptr *)&ota_uart_cb.URxDataPtr[0]; 
-        }
-
-        // 6. 物理缓冲区空间管理
-        // 判断剩余空间是否足够存放下一个最大包 (OTA_RX_MAX)M
-        if (OTA_RX_SIZE - ota_uart_cb.URxcounter >= OTA_RX_MAX) {
-            // 空间足够：下一个包接着当前位置存
-            ota_uart_cb.URxDataIN->start = (uint8_t *)&ota_rxbuff[ota_uart_cb.URxcounter];
-        }
-        else {
-            // 空间不足：从头开始存 (Rewind)
-            ota_uart_cb.URxDataIN->start = (uint8_t *)ota_rxbuff;
-            ota_uart_cb.URxcounter = 0;
-        }
-
-
-        // 7. 重新开启 DMA 接收
-        HAL_UART_Receive_DMA(&g_ota_uart_handle, (uint8_t *)ota_uart_cb.URxDataIN->start,  OTA_RX_MAX + 1); 
+        ota_uart_rx_event(1);
     }
-}
\ No newline at end of file
+}
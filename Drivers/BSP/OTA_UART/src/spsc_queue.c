@@ -0,0 +1,116 @@
+/**
+ * @file    spsc_queue.c
+ * @brief   单生产者/单消费者无锁队列实现文件
+ * @details 生产者先写元素再发布 head，消费者读完元素再发布 tail，两次发布前都有
+ *          数据存储器屏障 (DMB)，保证对方看到新计数时元素内容已经写入/不再使用。
+ *          head 与 tail 各自只有一方修改，不需要关中断。
+ */
+
+#include "spsc_queue.h"
+
+/**
+ * @brief  队列初始化
+ * @param  q    队列
+ * @param  buf  元素存储区 (size * num 字节)
+ * @param  size 元素大小 (字节)
+ * @param  num  容量，必须是 2 的幂
+ * @return None
+ */
+void spsc_init(spsc_queue *q, void *buf, uint16_t size, uint16_t num)
+{
+    q->buf = buf;
+    q->size = size;
+    q->mask = num - 1;
+    q->head = 0;
+    q->tail = 0;
+    q->dropped = 0;
+    q->highwater = 0;
+}
+
+/**
+ * @brief  元素入队 (生产者调用)
+ * @param  q    队列
+ * @param  item 元素
+ * @retval 1 成功
+ * @retval 0 队列满，元素被丢弃
+ */
+uint8_t spsc_push(spsc_queue *q, const void *item)
+{
+    uint16_t head = q->head;
+    uint16_t count = head - q->tail;
+
+    if (count > q->mask) {
+        q->dropped++;
+        return 0;
+    }
+    memcpy(&q->buf[(head & q->mask) * q->size], item, q->size);
+    __DMB(); // 元素写完后再发布
+    q->head = head + 1;
+
+    if (count + 1 > q->highwater) {
+        q->highwater = count + 1;
+    }
+    return 1;
+}
+
+/**
+ * @brief  查看队首元素 (消费者调用)，处理完后调用 spsc_pop
+ * @param  q 队列
+ * @return void* 队首元素，队列空时为 NULL
+ */
+void *spsc_peek(spsc_queue *q)
+{
+    uint16_t tail = q->tail;
+
+    if (q->head == tail) {
+        return NULL;
+    }
+    __DMB(); // 看到新 head 后再读元素
+    return &q->buf[(tail & q->mask) * q->size];
+}
+
+/**
+ * @brief  移除队首元素 (消费者调用)
+ * @param  q 队列
+ * @return None
+ */
+void spsc_pop(spsc_queue *q)
+{
+    if (q->head == q->tail) {
+        return;
+    }
+    __DMB(); // 元素用完后再释放槽位
+    q->tail++;
+}
+
+/**
+ * @brief  当前占用数
+ * @param  q 队列
+ * @return uint16_t 元素个数
+ */
+uint16_t spsc_count(spsc_queue *q)
+{
+    return (uint16_t)(q->head - q->tail);
+}
+
+/**
+ * @brief  队列是否为空
+ * @param  q 队列
+ * @retval 1 空
+ * @retval 0 非空
+ */
+uint8_t spsc_empty(spsc_queue *q)
+{
+    return q->head == q->tail;
+}
+
+/**
+ * @brief  队列是否已满
+ * @param  q 队列
+ * @retval 1 满
+ * @retval 0 未满
+ */
+uint8_t spsc_full(spsc_queue *q)
+{
+    return (uint16_t)(q->head - q->tail) > q->mask;
+}
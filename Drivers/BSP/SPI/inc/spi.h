@@ -47,6 +47,10 @@
 #define SPI1_SPI                        SPI1
 #define SPI1_SPI_CLK_ENABLE()           do{ __HAL_RCC_SPI1_CLK_ENABLE(); }while(0)    /* SPI1ʱʹ */
 
+/* SPI1 DMA ͨ (̶ӳ: SPI1_RX -> DMA1ͨ2, SPI1_TX -> DMA1ͨ3) */
+#define SPI1_RX_DMA                     DMA1_Channel2
+#define SPI1_TX_DMA                     DMA1_Channel3
+
 /******************************************************************************************/
 
 
@@ -61,9 +65,27 @@
 #define SPI_SPEED_256       7
 
 
+/**
+ * @brief       SPI1дһֽ (Ĵ, )
+ *   @note       spi1_read_write_byte ͬ, ֱӲѯ TXE/RXNE д DR,
+ *              ַ״̬ѯȶ̴, ʡȥÿֽһ HAL .
+ * @param       txdata  : Ҫ͵(1ֽ)
+ * @retval      յ(1ֽ)
+ */
+static inline uint8_t spi1_exchange(uint8_t txdata)
+{
+    while ((SPI1_SPI->SR & SPI_SR_TXE) == 0);
+    *(volatile uint8_t *)&SPI1_SPI->DR = txdata;
+    while ((SPI1_SPI->SR & SPI_SR_RXNE) == 0);
+    return (uint8_t)SPI1_SPI->DR;
+}
+
 void spi1_init(void);
 void spi1_set_speed(uint8_t speed);
 uint8_t spi1_read_write_byte(uint8_t txdata);
+void spi1_read_dma(uint8_t *pbuf, uint16_t len);    /* DMA ȡ (0XFF) */
+void spi1_write_dma(uint8_t *pbuf, uint16_t len);   /* DMA  () */
+void spi1_dma_deinit(void);                         /* ر DMA ͨ (ת APP ǰ) */
 
 #endif
 
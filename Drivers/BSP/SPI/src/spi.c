@@ -25,6 +25,8 @@
 #include "spi.h"
 
 SPI_HandleTypeDef g_spi1_handler; /* SPI1 */
+DMA_HandleTypeDef g_spi1_dma_rx;  /* SPI1  DMA  */
+DMA_HandleTypeDef g_spi1_dma_tx;  /* SPI1  DMA  */
 
 /**
  * @brief       SPIʼ
@@ -52,6 +54,29 @@ void spi1_init(void)
 
     __HAL_SPI_ENABLE(&g_spi1_handler); /* ʹSPI1 */
 
+    /* շõ DMA ͨ, ֻòѯʽ, ж */
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    g_spi1_dma_rx.Instance = SPI1_RX_DMA;
+    g_spi1_dma_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    g_spi1_dma_rx.Init.PeriphInc = DMA_PINC_DISABLE;
+    g_spi1_dma_rx.Init.MemInc = DMA_MINC_ENABLE;
+    g_spi1_dma_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    g_spi1_dma_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    g_spi1_dma_rx.Init.Mode = DMA_NORMAL;
+    g_spi1_dma_rx.Init.Priority = DMA_PRIORITY_HIGH;    /* ,  */
+    HAL_DMA_Init(&g_spi1_dma_rx);
+
+    g_spi1_dma_tx.Instance = SPI1_TX_DMA;
+    g_spi1_dma_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+    g_spi1_dma_tx.Init.PeriphInc = DMA_PINC_DISABLE;
+    g_spi1_dma_tx.Init.MemInc = DMA_MINC_ENABLE;
+    g_spi1_dma_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    g_spi1_dma_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    g_spi1_dma_tx.Init.Mode = DMA_NORMAL;
+    g_spi1_dma_tx.Init.Priority = DMA_PRIORITY_MEDIUM;
+    HAL_DMA_Init(&g_spi1_dma_tx);
+
     spi1_read_write_byte(0Xff); /* , ʵϾǲ8ʱ, ﵽDR, Ǳ */
 }
 
@@ -112,7 +137,79 @@ void spi1_set_speed(uint8_t speed)
  */
 uint8_t spi1_read_write_byte(uint8_t txdata)
 {
-    uint8_t rxdata;
-    HAL_SPI_TransmitReceive(&g_spi1_handler, &txdata, &rxdata, 1, 1000);
-    return rxdata; /* յ */
+    return spi1_exchange(txdata); /* յ */
+}
+
+/**
+ * @brief       SPI1 DMA ȫ˫ (ȴɺ󷵻)
+ *   @note      ͨ, ͨ,  SPI  DMA .
+ *              ͻղҪһʹõֽڻ岢رյַ.
+ * @param       txbuf   : 
+ * @param       txinc   : 1, ͵ַ; 0, ظ txbuf[0]
+ * @param       rxbuf   : ջ
+ * @param       rxinc   : 1, յַ; 0, д rxbuf[0]
+ * @param       len     : ֽ
+ * @retval      
+ */
+static void spi1_dma_transfer(uint8_t *txbuf, uint8_t txinc, uint8_t *rxbuf, uint8_t rxinc, uint16_t len)
+{
+    if (len == 0)
+    {
+        return;
+    }
+
+    while (SPI1_SPI->SR & SPI_SR_BSY);      /* ȴһֽڷ */
+    (void)SPI1_SPI->DR;                     /* Ľ */
+
+    MODIFY_REG(SPI1_RX_DMA->CCR, DMA_CCR_MINC, rxinc ? DMA_CCR_MINC : 0);
+    MODIFY_REG(SPI1_TX_DMA->CCR, DMA_CCR_MINC, txinc ? DMA_CCR_MINC : 0);
+
+    HAL_DMA_Start(&g_spi1_dma_rx, (uint32_t)&SPI1_SPI->DR, (uint32_t)rxbuf, len);
+    HAL_DMA_Start(&g_spi1_dma_tx, (uint32_t)txbuf, (uint32_t)&SPI1_SPI->DR, len);
+    SET_BIT(SPI1_SPI->CR2, SPI_CR2_RXDMAEN);
+    SET_BIT(SPI1_SPI->CR2, SPI_CR2_TXDMAEN);
+
+    HAL_DMA_PollForTransfer(&g_spi1_dma_rx, HAL_DMA_FULL_TRANSFER, 1000);  /* һֽյ */
+    HAL_DMA_PollForTransfer(&g_spi1_dma_tx, HAL_DMA_FULL_TRANSFER, 1000);
+
+    CLEAR_BIT(SPI1_SPI->CR2, SPI_CR2_TXDMAEN | SPI_CR2_RXDMAEN);
+}
+
+/**
+ * @brief       SPI1 DMA ȡ
+ * @param       pbuf    : ջ
+ * @param       len     : ֽ
+ * @retval      
+ */
+void spi1_read_dma(uint8_t *pbuf, uint16_t len)
+{
+    uint8_t dummy = 0XFF;
+
+    spi1_dma_transfer(&dummy, 0, pbuf, 1, len);
+}
+
+/**
+ * @brief       SPI1 DMA 
+ * @param       pbuf    : 
+ * @param       len     : ֽ
+ * @retval      
+ */
+void spi1_write_dma(uint8_t *pbuf, uint16_t len)
+{
+    uint8_t dummy;
+
+    spi1_dma_transfer(pbuf, 1, &dummy, 0, len);
+}
+
+/**
+ * @brief       ر SPI1  DMA ͨ
+ *   @note      ת APP ֮ǰ,  DMA1 ͨ2/3 ָλ״̬
+ * @param       
+ * @retval      
+ */
+void spi1_dma_deinit(void)
+{
+    CLEAR_BIT(SPI1_SPI->CR2, SPI_CR2_TXDMAEN | SPI_CR2_RXDMAEN);
+    HAL_DMA_DeInit(&g_spi1_dma_rx);
+    HAL_DMA_DeInit(&g_spi1_dma_tx);
 }
@@ -39,6 +39,9 @@
 #define STM32_SECTOR_SIZE   2048                /* ڵ256K F103, СΪ2Kֽ */
 #endif
 
+/* ϡд: ֵΪ0XFFFF(̬)İֲ */
+#define STM32_FLASH_SPARSE      1
+
 /* FLASHֵ */
 #define STM32_FLASH_KEY1        0X45670123
 #define STM32_FLASH_KEY2        0XCDEF89AB
@@ -54,8 +57,21 @@
 /* ӿں(ⲿɵ) */
 uint16_t stmflash_read_halfword(uint32_t faddr);                        /* FLASH */
 void stmflash_read(uint32_t raddr, uint16_t *pbuf, uint16_t length);    /* ַָʼָȵ */
-void stmflash_write(uint32_t waddr, uint16_t *pbuf, uint16_t length);   /* FLASH ָλ, дָȵ(Զ) */
+uint8_t stmflash_write(uint32_t waddr, uint16_t *pbuf, uint16_t length);    /* FLASH ָλ, дָȵ(Զ) */
+void stmflash_write_nocheck(uint32_t waddr, uint16_t *pbuf, uint16_t length);   /* д(Ƚ) */
 void stmflash_erase(uint32_t addr, uint8_t pages);
+uint32_t stmflash_used_pages(uint32_t saddr, uint32_t pages);           /* һǿҳ֮ǰҳ */
+
+/* ͳ (/ں RAM ִ,  .RamFunc ) */
+void stmflash_perf_reset(void);                                         /* ͳ */
+uint32_t stmflash_perf_rate(uint32_t *halfwords);                       /* ÿ̰, ʵʱ̵İ */
+
+/* ʽдỰ: ͬҳ, Ҫʱһ, Ựڼ䱣ֽ */
+uint8_t stmflash_session_begin(uint32_t saddr, uint32_t total_len);     /* ʼỰ */
+uint8_t stmflash_session_active(void);                                  /* ỰǷ */
+uint8_t stmflash_session_write(uint8_t *pbuf, uint32_t len);            /* ˳д, 1ʾỰʧ */
+uint8_t stmflash_session_end(void);                                     /* Ự, 1ʾдʧ */
+void stmflash_session_stat(uint32_t *skipped, uint32_t *erased, uint32_t *programmed);  /* //̵ҳ */
 /* Ժ */
 void test_write(uint32_t waddr, uint16_t wdata);
 
@@ -23,8 +23,91 @@
  */
 
 #include "delay.h"
+#include "scratch.h"
 #include "stmflash.h"
 
+/*  RAM ִеĺ: ʱ .data δ FLASH  RAM,  .text ೬ BL Χ, Ҫת */
+#define STMFLASH_RAMFUNC    __RAM_FUNC __attribute__((long_call, noinline))
+
+/* ͳ */
+static struct
+{
+    uint32_t halfwords; /* ʵʱ̵İ (ϡдʱ0XFFFF) */
+    uint32_t cycles;    /* ̺ķѵ CPU  */
+} g_stmflash_perf;
+
+/**
+ * @brief       Ĵֱں ( RAM ִ)
+ *   @note      ֱӲ FLASH->CR  PG λѯ SR  BSY λ, ʡȥ HAL_FLASH_Program
+ *              ÿֵ״̬/ʱ/.  RAM , FLASH æʱ CPU 
+ *              ȡָͣ. ǰѽ.
+ *              ϡдʱֵΪ0XFFFFİ: ̬0XFFFF, ڷǲ̬д0XFFFF
+ *              Ҳ̴ֻı, дͬ.
+ * @param       waddr   : ʼַ (˵ַΪ2ı!!)
+ * @param       pbuf    : ָ
+ * @param       length  : Ҫд (16λ)
+ * @param       programmed : ۼʵʱ̵İ
+ * @retval      0, ɹ; 1, ̴д
+ */
+static STMFLASH_RAMFUNC uint8_t stmflash_ram_program(uint32_t waddr, uint16_t *pbuf, uint32_t length, uint32_t *programmed)
+{
+    uint8_t res = 0;
+
+    FLASH->SR = FLASH_SR_EOP | FLASH_SR_PGERR | FLASH_SR_WRPRTERR;  /* ϴε״̬ */
+    FLASH->CR |= FLASH_CR_PG;
+
+    for (; length; length--, waddr += 2, pbuf++)
+    {
+#if STM32_FLASH_SPARSE
+        if (*pbuf == 0XFFFF)
+        {
+            continue;
+        }
+#endif
+        *(volatile uint16_t *)waddr = *pbuf;
+        while (FLASH->SR & FLASH_SR_BSY);
+        if (FLASH->SR & (FLASH_SR_PGERR | FLASH_SR_WRPRTERR))
+        {
+            res = 1;
+            break;
+        }
+        (*programmed)++;
+    }
+
+    FLASH->CR &= ~FLASH_CR_PG;
+    return res;
+}
+
+/**
+ * @brief       Ĵҳں ( RAM ִ)
+ * @param       addr    : һҳĵַ
+ * @param       pages   : ҳ
+ * @retval      0, ɹ; 1, д
+ */
+static STMFLASH_RAMFUNC uint8_t stmflash_ram_erase(uint32_t addr, uint32_t pages)
+{
+    uint8_t res = 0;
+
+    FLASH->SR = FLASH_SR_EOP | FLASH_SR_PGERR | FLASH_SR_WRPRTERR;
+    FLASH->CR |= FLASH_CR_PER;
+
+    while (pages--)
+    {
+        FLASH->AR = addr;
+        FLASH->CR |= FLASH_CR_STRT;
+        while (FLASH->SR & FLASH_SR_BSY);
+        if (FLASH->SR & FLASH_SR_WRPRTERR)
+        {
+            res = 1;
+            break;
+        }
+        addr += STM32_SECTOR_SIZE;
+    }
+
+    FLASH->CR &= ~FLASH_CR_PER;
+    return res;
+}
+
 /**
  * @brief       ַָȡһ (16λ)
  * @param       faddr   : ȡַ (˵ַΪ2ı!!)
@@ -63,12 +146,11 @@ void stmflash_read(uint32_t raddr, uint16_t *pbuf, uint16_t length)
  */
 void stmflash_write_nocheck(uint32_t waddr, uint16_t *pbuf, uint16_t length)
 {
-    uint16_t i;
-    for (i = 0; i < length; i++)
-    {
-        HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, waddr, pbuf[i]);
-        waddr += 2; /* ָһ */
-    }
+    uint32_t start = DWT->CYCCNT;
+
+    stmflash_ram_program(waddr, pbuf, length, &g_stmflash_perf.halfwords);
+
+    g_stmflash_perf.cycles += DWT->CYCCNT - start;
 }
 
 /**
@@ -80,22 +162,26 @@ void stmflash_write_nocheck(uint32_t waddr, uint16_t *pbuf, uint16_t length)
  * @param       waddr   : ʼַ (˵ַΪ2ı!!,д!)
  * @param       pbuf    : ָ
  * @param       length  : Ҫд (16λ)
- * @retval      
+ * @retval      0, ɹ; 1, ַǷ費, ûд
  */
-uint16_t g_flashbuf[STM32_SECTOR_SIZE / 2]; /* 2Kֽ */
-void stmflash_write(uint32_t waddr, uint16_t *pbuf, uint16_t length)
+uint8_t stmflash_write(uint32_t waddr, uint16_t *pbuf, uint16_t length)
 {
+    uint16_t *flashbuf;   /* , 2Kֽ, ӹ */
     uint32_t secpos;    /* ַ */
     uint16_t secoff;    /* ƫƵַ(16λּ) */
     uint16_t secremain; /* ʣַ(16λּ) */
     uint16_t i;
     uint32_t offaddr;   /* ȥ0X08000000ĵַ */
-    FLASH_EraseInitTypeDef flash_eraseop;
-    uint32_t erase_addr;   /* ֵΪַ */
 
     if (waddr < STM32_FLASH_BASE || (waddr >= (STM32_FLASH_BASE + STM32_FLASH_SIZE)))
     {
-        return; /* Ƿַ */
+        return 1; /* Ƿַ */
+    }
+
+    flashbuf = scratch_borrow(SCRATCH_STMFLASH, STM32_SECTOR_SIZE);
+    if (flashbuf == NULL)
+    {
+        return 1; /* ʧ, ֱ˳ */
     }
 
     HAL_FLASH_Unlock();                       /* FLASH */
@@ -111,27 +197,23 @@ void stmflash_write(uint32_t waddr, uint16_t *pbuf, uint16_t length)
 
     while (1)
     {
-        stmflash_read(secpos * STM32_SECTOR_SIZE + STM32_FLASH_BASE, g_flashbuf, STM32_SECTOR_SIZE / 2); /*  */
+        stmflash_read(secpos * STM32_SECTOR_SIZE + STM32_FLASH_BASE, flashbuf, STM32_SECTOR_SIZE / 2); /*  */
         for (i = 0; i < secremain; i++)                                                              /* У */
         {
-            if (g_flashbuf[secoff + i] != 0XFFFF)
+            if (flashbuf[secoff + i] != 0XFFFF)
             {
                 break; /* Ҫ */
             }
         }
         if (i < secremain) /* Ҫ */
         { 
-            flash_eraseop.TypeErase = FLASH_TYPEERASE_PAGES;        /* ѡ */
-            flash_eraseop.Banks = FLASH_BANK_1;
-            flash_eraseop.NbPages = 1;
-            flash_eraseop.PageAddress = secpos * STM32_SECTOR_SIZE + STM32_FLASH_BASE;  /* Ҫ */
-            HAL_FLASHEx_Erase( &flash_eraseop, &erase_addr);
+            stmflash_ram_erase(secpos * STM32_SECTOR_SIZE + STM32_FLASH_BASE, 1);  /*  */
 
             for (i = 0; i < secremain; i++)                               /*  */
             {
-                g_flashbuf[i + secoff] = pbuf[i];
+                flashbuf[i + secoff] = pbuf[i];
             }
-            stmflash_write_nocheck(secpos * STM32_SECTOR_SIZE + STM32_FLASH_BASE, g_flashbuf, STM32_SECTOR_SIZE / 2); /* д */
+            stmflash_write_nocheck(secpos * STM32_SECTOR_SIZE + STM32_FLASH_BASE, flashbuf, STM32_SECTOR_SIZE / 2); /* д */
         }
         else
         {
@@ -160,6 +242,8 @@ void stmflash_write(uint32_t waddr, uint16_t *pbuf, uint16_t length)
     }
 
     HAL_FLASH_Lock(); /*  */
+    scratch_return(SCRATCH_STMFLASH);
+    return 0;
 }
 
 /**
@@ -170,17 +254,369 @@ void stmflash_write(uint32_t waddr, uint16_t *pbuf, uint16_t length)
 void stmflash_erase(uint32_t addr, uint8_t pages)
 {
     HAL_FLASH_Unlock();                       /* FLASH */
-    FLASH_EraseInitTypeDef flash_eraseop;
-    uint32_t erase_addr;   /* ֵΪַ */
-    
-    flash_eraseop.TypeErase = FLASH_TYPEERASE_PAGES;        /* ѡ */
-    flash_eraseop.Banks = FLASH_BANK_1;
-    flash_eraseop.NbPages = pages;
-    flash_eraseop.PageAddress = addr;
-    HAL_FLASHEx_Erase( &flash_eraseop, &erase_addr);
+    stmflash_ram_erase(addr, pages);
     HAL_FLASH_Lock(); /*  */
 }
 
+/**
+ * @brief       һǿҳ
+ *   @note      ĩβǰּ, һȫ0XFFFFFFFFҳ
+ * @param       saddr : ʼַ (ҳ)
+ * @param       pages : ҳ
+ * @retval      Ҫҳ (һǿҳ֮ǰҳ), ȫʱΪ0
+ */
+uint32_t stmflash_used_pages(uint32_t saddr, uint32_t pages)
+{
+    uint32_t addr;
+    uint32_t i;
+
+    while (pages)
+    {
+        addr = saddr + (pages - 1) * STM32_SECTOR_SIZE;
+        for (i = 0; i < STM32_SECTOR_SIZE; i += 4)
+        {
+            if (*(volatile uint32_t *)(addr + i) != 0XFFFFFFFF)
+            {
+                return pages;
+            }
+        }
+        pages--;
+    }
+    return 0;
+}
+
+/**
+ * @brief       ͳ,  DWT ڼ
+ * @param       
+ * @retval      
+ */
+void stmflash_perf_reset(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    g_stmflash_perf.halfwords = 0;
+    g_stmflash_perf.cycles = 0;
+}
+
+/**
+ * @brief       ȡ
+ * @param       halfwords : ѱ̵İ, ΪNULL
+ * @retval      ÿ̵İ (ֻƱʱ, ), ûͳʱΪ0
+ */
+uint32_t stmflash_perf_rate(uint32_t *halfwords)
+{
+    if (halfwords != NULL)
+    {
+        *halfwords = g_stmflash_perf.halfwords;
+    }
+    if (g_stmflash_perf.cycles == 0)
+    {
+        return 0;
+    }
+    return (uint32_t)((uint64_t)g_stmflash_perf.halfwords * SystemCoreClock / g_stmflash_perf.cycles);
+}
+
+/******************************************************************************************/
+/* ʽдỰ */
+
+/**
+ * @brief ʽдỰƿ
+ */
+static struct
+{
+    uint32_t addr;      /* һдַ */
+    uint32_t end;       /* ַ */
+    uint32_t page;      /* ǰҳַ, 0XFFFFFFFF ʾûд򿪵ҳ */
+    uint8_t page_erased;        /* ǰҳѲ */
+    uint8_t page_programmed;    /* ǰҳаֱ */
+    uint8_t carry;      /* ֵʣֽ */
+    uint8_t has_carry;  /* carry Ч */
+    uint8_t active;     /* Ự */
+    uint8_t error;      /* дʧ, дָͣʧܴ, ֮дȫܾ */
+    uint16_t skipped;   /* ͬҳ */
+    uint16_t erased;    /* ҳ */
+    uint16_t programmed;/* б̵ҳ */
+} g_stmflash_session;
+
+/**
+ * @brief       ֻ FLASH ݲͬİ
+ *   @note      ֤߱ЩֵǰΪ 0XFFFF ͬ
+ * @param       waddr   : ʼַ
+ * @param       pbuf    : ָ
+ * @param       length  : 
+ * @retval      1, аֱ; 0, ͬ
+ */
+static uint8_t stmflash_program_diff(uint32_t waddr, uint16_t *pbuf, uint32_t length)
+{
+    uint32_t i = 0;
+    uint32_t run;
+    uint8_t programmed = 0;
+
+    while (i < length)
+    {
+        while (i < length && stmflash_read_halfword(waddr + 2 * i) == pbuf[i])
+        {
+            i++;    /* ͬİ */
+        }
+        run = i;
+        while (i < length && stmflash_read_halfword(waddr + 2 * i) != pbuf[i])
+        {
+            i++;
+        }
+        if (i > run)
+        {
+            stmflash_write_nocheck(waddr + 2 * run, &pbuf[run], i - run);
+            programmed = 1;
+        }
+    }
+    return programmed;
+}
+
+/**
+ * @brief       ǰҳͳ
+ * @param       
+ * @retval      
+ */
+static void stmflash_session_close_page(void)
+{
+    if (g_stmflash_session.page != 0XFFFFFFFF)
+    {
+        if (g_stmflash_session.page_programmed)
+        {
+            g_stmflash_session.programmed++;
+        }
+        else if (!g_stmflash_session.page_erased)
+        {
+            g_stmflash_session.skipped++;   /* ûб仯, ûҲû */
+        }
+    }
+    g_stmflash_session.page = 0XFFFFFFFF;
+}
+
+/**
+ * @brief       Ựдɰ (ַѰֶ)
+ *   @note       FLASH ݱȽ: ͬ, Ϊ 0XFFFF ֱӱ,
+ *              ҳҪ: Ȱҳдָ֮ǰݶõĻ, 
+ *              д, ټ. ȫͬҳҲ.
+ *              費ҳʧʱܼ˳д, ỰΪʧ.
+ * @param       pbuf    : ָ
+ * @param       num     : 
+ * @retval      0, ɹ; 1, Ựʧ
+ */
+static uint8_t stmflash_session_put(uint16_t *pbuf, uint32_t num)
+{
+    uint32_t addr;
+    uint32_t page;
+    uint32_t n;
+    uint32_t i;
+    uint16_t old;
+    uint16_t *flashbuf;
+
+    if (g_stmflash_session.error)
+    {
+        return 1;
+    }
+
+    while (num && g_stmflash_session.addr < g_stmflash_session.end)
+    {
+        addr = g_stmflash_session.addr;
+        page = addr - (addr - STM32_FLASH_BASE) % STM32_SECTOR_SIZE;
+        if (page != g_stmflash_session.page)
+        {
+            stmflash_session_close_page();
+            g_stmflash_session.page = page;
+            g_stmflash_session.page_erased = 0;
+            g_stmflash_session.page_programmed = 0;
+        }
+
+        n = (page + STM32_SECTOR_SIZE - addr) / 2;  /* ҳʣ */
+        if (n > num)
+        {
+            n = num;
+        }
+
+        if (!g_stmflash_session.page_erased)
+        {
+            for (i = 0; i < n; i++)
+            {
+                old = stmflash_read_halfword(addr + 2 * i);
+                if (old != pbuf[i] && old != 0XFFFF)
+                {
+                    break;  /* ֱӱ, Ҫ */
+                }
+            }
+            if (i < n)
+            {
+                flashbuf = scratch_borrow(SCRATCH_STMFLASH, STM32_SECTOR_SIZE);
+                if (flashbuf == NULL)
+                {
+                    g_stmflash_session.error = 1;   /* ʧ, ܲ */
+                    return 1;
+                }
+                stmflash_read(page, flashbuf, (addr - page) / 2);     /* ҳдĲ */
+                if (stmflash_ram_erase(page, 1))
+                {
+                    scratch_return(SCRATCH_STMFLASH);
+                    g_stmflash_session.error = 1;   /* д */
+                    return 1;
+                }
+                g_stmflash_session.page_erased = 1;
+                g_stmflash_session.erased++;
+                if (stmflash_program_diff(page, flashbuf, (addr - page) / 2))
+                {
+                    g_stmflash_session.page_programmed = 1;
+                }
+                scratch_return(SCRATCH_STMFLASH);
+            }
+        }
+
+        if (stmflash_program_diff(addr, pbuf, n))
+        {
+            g_stmflash_session.page_programmed = 1;
+        }
+
+        g_stmflash_session.addr += n * 2;
+        pbuf += n;
+        num -= n;
+    }
+    return 0;
+}
+
+/**
+ * @brief       ʼһʽдỰ
+ *   @note      Ựڼ FLASH ֽ, дֻ˳:
+ *              дǰ FLASH ݱȽ, ͬҳ, ֻ޷ֱӱʱ
+ *              Ųҳ(ÿҳһ), ٶҳȽ.
+ * @param       saddr     : ʼַ (˵ַΪ2ı!!)
+ * @param       total_len : ֽ ()
+ * @retval      0, ɹ; 1, ַǷ
+ */
+uint8_t stmflash_session_begin(uint32_t saddr, uint32_t total_len)
+{
+    if (saddr < STM32_FLASH_BASE || (saddr + total_len > (STM32_FLASH_BASE + STM32_FLASH_SIZE)))
+    {
+        return 1;   /* Ƿַ */
+    }
+
+    HAL_FLASH_Unlock();     /* Ựֻһ */
+
+    g_stmflash_session.addr = saddr;
+    g_stmflash_session.end = saddr + total_len;
+    g_stmflash_session.page = 0XFFFFFFFF;
+    g_stmflash_session.has_carry = 0;
+    g_stmflash_session.skipped = 0;
+    g_stmflash_session.erased = 0;
+    g_stmflash_session.programmed = 0;
+    g_stmflash_session.error = 0;
+    g_stmflash_session.active = 1;
+    return 0;
+}
+
+/**
+ * @brief       ỰǷ
+ * @retval      1, ; 0, ûлỰ
+ */
+uint8_t stmflash_session_active(void)
+{
+    return g_stmflash_session.active;
+}
+
+/**
+ * @brief       Ự˳д
+ *   @note      ȿ, ֵֽڱһдỰ.
+ *              Ựʧܺݲд, Ӧֹ.
+ * @param       pbuf : ָ
+ * @param       len  : ֽ
+ * @retval      0, ɹ; 1, ûлỰỰʧ
+ */
+uint8_t stmflash_session_write(uint8_t *pbuf, uint32_t len)
+{
+    uint16_t halfword;
+    uint32_t count;
+
+    if (!g_stmflash_session.active)
+    {
+        return 1;
+    }
+    if (len == 0)
+    {
+        return g_stmflash_session.error;
+    }
+
+    if (g_stmflash_session.has_carry)   /* Ȳϴʣֽ */
+    {
+        halfword = g_stmflash_session.carry | (*pbuf++ << 8);
+        stmflash_session_put(&halfword, 1);
+        g_stmflash_session.has_carry = 0;
+        len--;
+    }
+
+    count = len / 2;
+    if ((uint32_t)pbuf & 1)     /* δֶ, ƴ */
+    {
+        while (count--)
+        {
+            halfword = pbuf[0] | (pbuf[1] << 8);
+            stmflash_session_put(&halfword, 1);
+            pbuf += 2;
+        }
+    }
+    else
+    {
+        stmflash_session_put((uint16_t *)pbuf, count);
+        pbuf += count * 2;
+    }
+
+    if (len & 1)
+    {
+        g_stmflash_session.carry = *pbuf;
+        g_stmflash_session.has_carry = 1;
+    }
+    return g_stmflash_session.error;
+}
+
+/**
+ * @brief       дỰ
+ *   @note      ʣֽ 0XFF д, Ȼ FLASH 
+ * @param       
+ * @retval      0, Ựеȫд (ûлỰ); 1, Ựдʧ
+ */
+uint8_t stmflash_session_end(void)
+{
+    uint16_t halfword;
+
+    if (!g_stmflash_session.active)
+    {
+        return 0;
+    }
+
+    if (g_stmflash_session.has_carry)
+    {
+        halfword = g_stmflash_session.carry | 0XFF00;
+        stmflash_session_put(&halfword, 1);
+        g_stmflash_session.has_carry = 0;
+    }
+    stmflash_session_close_page();
+
+    g_stmflash_session.active = 0;
+    HAL_FLASH_Lock();   /*  */
+    return g_stmflash_session.error;
+}
+
+/**
+ * @brief       ȡһ(ǰ)Ựҳͳ
+ * @param       skipped     : ͬҳ
+ * @param       erased      : زҳ
+ * @param       programmed  : б̵ҳ
+ * @retval      
+ */
+void stmflash_session_stat(uint32_t *skipped, uint32_t *erased, uint32_t *programmed)
+{
+    *skipped = g_stmflash_session.skipped;
+    *erased = g_stmflash_session.erased;
+    *programmed = g_stmflash_session.programmed;
+}
+
 /******************************************************************************************/
 /* ô */
 
@@ -3,10 +3,56 @@
 
 #include "main.h"
 
+// Xmodem 控制字符
+#define XMODEM_SOH 0x01 // 128字节数据包头
+#define XMODEM_STX 0x02 // 1024字节数据包头 (Xmodem-1K)
+#define XMODEM_EOT 0x04 // 传输结束
+#define XMODEM_ACK 0x06 // 应答
+#define XMODEM_NAK 0x15 // 非应答
+#define XMODEM_CAN 0x18 // 取消传输
+
+// Xmodem 数据包长度 (头1 + 包号1 + 反码1 + 数据 + CRC2)
+#define XMODEM_SOH_DATA 128
+#define XMODEM_STX_DATA 1024
+#define XMODEM_SOH_LEN (XMODEM_SOH_DATA + 5)
+#define XMODEM_STX_LEN (XMODEM_STX_DATA + 5)
+
+// 后台页写入每步编程的字节数 (外部 Flash 一页)
+#define OTA_COMMIT_CHUNK 256
+
+// A 区擦除每批擦除的页数 (每批之后报告进度)
+#define OTA_ERASE_BATCH 8
+
+// 外部 Flash 预擦除页位图的字数 (固件记录最大为 A 区大小)
+#define OTA_PREERASE_WORDS ((F103RC_A_PAGE_NUM + 31) / 32)
+
+// 固件接收错误码 (解压、差分补丁、写入)
+#define OTA_OK 0
+#define OTA_ERR_HEAD 1 // 压缩头参数不支持
+#define OTA_ERR_SIZE 2 // 固件超出目标区域大小
+#define OTA_ERR_DATA 3 // 数据错误
+#define OTA_ERR_BASE 4 // 找不到差分补丁的基准固件
+#define OTA_ERR_FLASH 5 // 目标存储器写入失败
+
 typedef void (*load)(void); // 跳转APP区函数指针
 
 void bootloader_brance(void);
 void bootloader_event(uint8_t *data, uint16_t datalen);
+void bootloader_store(uint8_t *data, uint16_t len);
+uint8_t bootloader_receive(uint8_t *data, uint16_t len);
+uint8_t bootloader_commit_busy(void);
+void bootloader_commit_poll(void);
+uint8_t bootloader_unpacked(uint8_t *data, uint16_t len);
+uint8_t bootloader_receive_complete(void);
+uint8_t bootloader_find_base(uint32_t len, uint32_t crc, uint32_t *base);
+uint32_t bootloader_target_size(void);
+void bootloader_erase_a(uint32_t len);
+void bootloader_download_finish(void);
+void bootloader_download_abort(void);
 uint16_t xmodem_crc16(uint8_t *pdata, uint32_t len);
+uint8_t bootloader_check_a(void);
+uint8_t bootloader_image(uint32_t id, uint32_t *addr, uint32_t *len);
+uint8_t bootloader_check_slot(uint32_t id);
+uint8_t bootloader_check_install(uint32_t id);
 #endif
 
@@ -0,0 +1,60 @@
+/**
+ * @file ota_catalog.h
+ * @brief 外部 Flash 固件目录 (日志结构)
+ *
+ * 外部 Flash 布局:
+ * | 0 号下载区 (APP 写入, 长度与 CRC 记录在 EEPROM) | 目录区: 固件记录 ... 到芯片末尾 |
+ * 目录区的结束地址按 norflash_init 识别到的芯片容量确定，未知芯片不使用目录。
+ * 每条固件记录从 4KB 扇区边界开始，第一个扇区是记录头，之后是固件数据:
+ * | 记录头 (ota_catalog_head) ... 4KB | 固件数据 (长度按 4KB 向上取整) |
+ * 记录头分两次写入: 开始下载时写入编号、序号、版本号与 hcrc，下载完成后在同一
+ * 扇区中原本为 0xFF 的位置写入长度、CRC 与 fcrc。没有 fcrc 的记录是未完成的
+ * 下载 (中止或掉电)，不会被使用。
+ * 同一编号以序号最大的完整记录为准，旧记录与未完成记录占用的空间可以再分配。
+ * 第一次使用目录时按扇区扫描一次目录区，索引缓存在 RAM 中，按编号直接查找。
+ */
+#ifndef OTA_CATALOG_H
+#define OTA_CATALOG_H
+
+#include "main.h"
+#include "norflash.h"
+
+#define OTA_CATALOG_BASE (256 * 1024)       // 目录区起始地址 (前 256KB 为 0 号下载区，可容纳 A 区固件)
+#define OTA_CATALOG_SECTOR 4096             // 记录对齐单位 (擦除扇区)
+#define OTA_CATALOG_HEAD OTA_CATALOG_SECTOR // 记录头占用一个扇区，固件数据从扇区边界开始
+#define OTA_CATALOG_IDS 32                  // 固件编号 1 ~ OTA_CATALOG_IDS-1
+#define OTA_CATALOG_MAGIC 0x474C5441        // "ATLG"
+
+/**
+ * @brief 记录头 (外部 Flash 中的格式)
+ */
+typedef struct
+{
+    uint32_t magic;  // OTA_CATALOG_MAGIC
+    uint32_t id;     // 固件编号
+    uint32_t seq;    // 写入序号，越大越新 (没有 RTC，同时作为写入时间顺序)
+    uint8_t ver[32]; // 写入时的版本号字符串 (VER-x.x.x-y/m/d-h:m，含日期时间)
+    uint32_t hcrc;   // 以上字段的 CRC32
+    uint32_t len;    // 固件长度 (下载完成时写入)
+    uint32_t crc;    // 固件 CRC32 (下载完成时写入)
+    uint32_t fcrc;   // len、crc 的 CRC32，有效表示记录完整
+}ota_catalog_head;
+
+/**
+ * @brief 目录索引项 (RAM)
+ */
+typedef struct
+{
+    uint32_t addr; // 固件数据地址，0 表示没有该编号的固件
+    uint32_t len;  // 固件长度
+    uint32_t crc;  // 固件 CRC32
+    uint32_t seq;  // 写入序号
+}ota_image;
+
+const ota_image *ota_catalog_find(uint32_t id);
+uint32_t ota_catalog_begin(uint32_t id, uint32_t maxlen, norflash_cb erased);
+void ota_catalog_end(uint32_t len, uint32_t crc);
+void ota_catalog_cancel(void);
+void ota_catalog_info(void);
+
+#endif // !OTA_CATALOG_H
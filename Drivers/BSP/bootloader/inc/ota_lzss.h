@@ -0,0 +1,25 @@
+/**
+ * @file ota_lzss.h
+ * @brief 压缩固件流式解压 (LZSS，heatshrink 位流格式)
+ *
+ * 压缩文件格式:
+ * | 'H' 'S' 'Z' | 参数1 | 原始长度4 (小端) | 位流 |
+ * 参数高4位为窗口位数 W，低4位为长度位数 L。位流按字节高位在先：
+ * - 1 + 8位字面量
+ * - 0 + W位 (距离-1) + L位 (长度-1)，从已解压数据中回溯复制
+ * 位流与 heatshrink (-w W -l L) 相同，其输出加上压缩头即可使用。主机端压缩工具见 tools/lzss.py。
+ */
+#ifndef OTA_LZSS_H
+#define OTA_LZSS_H
+
+#include "main.h"
+
+#define LZSS_HEAD_LEN 8         // 魔数3 + 参数1 + 原始长度4
+#define LZSS_WINDOW_BITS_MAX 11 // 最大窗口位数，窗口缓冲区 2KB
+
+uint8_t ota_lzss_detect(uint8_t *data, uint16_t len);
+void ota_lzss_init(uint32_t maxlen);
+uint8_t ota_lzss_input(uint8_t *data, uint16_t len);
+uint8_t ota_lzss_done(void);
+
+#endif // !OTA_LZSS_H
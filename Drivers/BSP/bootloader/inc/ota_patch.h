@@ -0,0 +1,31 @@
+/**
+ * @file ota_patch.h
+ * @brief 差分升级补丁 (bsdiff 式流式补丁)
+ *
+ * 补丁格式 (多字节字段小端):
+ * | 'D' 'P' 'T' '1' | 旧固件长度4 | 旧固件CRC32 4 | 新固件长度4 | 新固件CRC32 4 |
+ * 之后为若干条记录，每条记录:
+ * | 差分长度4 | 新增长度4 | 旧固件偏移调整4 (有符号) | 差分数据 | 新增数据 |
+ * 差分数据逐字节与旧固件相加得到新固件，新增数据直接输出；一条记录结束后
+ * 旧固件读取位置加上偏移调整。CRC32 与硬件 CRC 单元一致 (见 crc32.h)。
+ * 主机端补丁生成工具见 tools/ota_patch.py。
+ */
+#ifndef OTA_PATCH_H
+#define OTA_PATCH_H
+
+#include "main.h"
+
+#define PATCH_HEAD_LEN 20  // 魔数4 + 旧长度4 + 旧CRC4 + 新长度4 + 新CRC4
+#define PATCH_CTRL_LEN 12  // 差分长度4 + 新增长度4 + 偏移调整4
+#define PATCH_OLD_BUF 256  // 旧固件读缓冲 (外部 Flash 基准)
+#define PATCH_OUT_BUF 256  // 新固件输出缓冲
+
+#define PATCH_BASE_A 0xFFFFFFFF  // 基准固件位于 A 区，否则为外部 Flash 地址
+
+uint8_t ota_patch_detect(uint8_t *data, uint16_t len);
+void ota_patch_init(uint32_t maxlen);
+uint8_t ota_patch_input(uint8_t *data, uint16_t len);
+uint8_t ota_patch_done(void);
+uint32_t ota_patch_crc(void);
+
+#endif // !OTA_PATCH_H
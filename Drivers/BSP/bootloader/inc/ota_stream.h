@@ -0,0 +1,57 @@
+/**
+ * @file ota_stream.h
+ * @brief 滑动窗口流式传输协议
+ *
+ * 帧格式 (多字节字段小端，CRC 高位在先):
+ * | 0xA5 | 类型1 | 序号2 | 长度2 | 负载 0~1024 | CRC16 2 |
+ * CRC16 与 Xmodem 相同，覆盖 类型~负载。
+ *
+ * 波特率协商 (START 之前):
+ * 1. 主机以当前波特率发送 STREAM_BAUD，设备回复 STREAM_BAUD_ACK 后切换到新波特率。
+ * 2. 主机切换后发送 STREAM_TEST，设备以新波特率回复 STREAM_TEST_ACK，协商完成。
+ * 3. 设备 STREAM_BAUD_TIMEOUT 内未收到测试帧则恢复原波特率；主机未收到应答时
+ *    同样恢复原波特率，等待设备超时后用 STREAM_TEST 确认双方一致。
+ * 传输结束 (DONE/ABORT) 或长时间没有有效帧时，设备恢复进入流式传输时的波特率。
+ */
+#ifndef OTA_STREAM_H
+#define OTA_STREAM_H
+
+#include "main.h"
+
+// 帧结构定义
+#define STREAM_SYNC 0xA5      // 帧头
+#define STREAM_HEAD_LEN 6     // 帧头1 + 类型1 + 序号2 + 长度2
+#define STREAM_DATA_MAX 1024  // 单帧最大负载
+#define STREAM_FRAME_MAX (STREAM_HEAD_LEN + STREAM_DATA_MAX + 2)
+#define STREAM_WINDOW 4       // 接收窗口 (允许未确认的帧数)
+#define STREAM_SLOTS (STREAM_WINDOW - 1) // 重排缓冲区槽位数 (期望的帧直接提交，不占槽位)
+
+// 帧类型 (主机 -> 设备)
+#define STREAM_START 0x01 // 开始传输，负载为固件总长度 (uint32)
+#define STREAM_DATA 0x02  // 数据帧，序号从 0 开始
+#define STREAM_END 0x03   // 结束传输，序号为总帧数
+#define STREAM_BAUD 0x04  // 波特率协商，负载为新波特率 (uint32)
+#define STREAM_TEST 0x05  // 测试帧，负载 0~8 字节，设备原样回复
+
+// 帧类型 (设备 -> 主机)
+#define STREAM_ACK 0x80   // 应答：序号为下一个期望帧，负载1字节位图，bit i 表示 序号+1+i 已收到
+#define STREAM_ABORT 0x81 // 中止：负载1字节原因
+#define STREAM_DONE 0x82  // 完成：全部数据已提交，序号为总帧数
+#define STREAM_BAUD_ACK 0x83  // 波特率应答：负载为将要切换的波特率 (uint32)，0 表示拒绝
+#define STREAM_TEST_ACK 0x84  // 测试帧应答：负载与测试帧相同
+
+// 中止原因
+#define STREAM_ERR_SIZE 0x01 // 固件超出目标区域大小
+#define STREAM_ERR_DATA 0x02 // 压缩或补丁数据错误、不完整
+#define STREAM_ERR_BASE 0x03 // 找不到差分补丁的基准固件
+#define STREAM_ERR_FLASH 0x04 // 写入 Flash 失败
+
+// 超时 (ms)
+#define STREAM_BAUD_TIMEOUT 500  // 切换波特率后等待测试帧
+#define STREAM_IDLE_TIMEOUT 3000 // 非默认波特率下没有有效帧，恢复默认波特率
+
+void ota_stream_init(void);
+void ota_stream_input(uint8_t *data, uint16_t len);
+void ota_stream_poll(void);
+
+#endif // !OTA_STREAM_H
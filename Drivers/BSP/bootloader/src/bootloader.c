@@ -3,10 +3,13 @@
  * @brief   STM32 UART IAP (In-Application Programming) Bootloader 实现文件
  * @details 该文件实现了基于串口的 Bootloader 功能，主要包括：
  *          1. 通过 Xmodem 协议下载固件到内部 Flash (APP区)。
- *          2. 支持将固件下载到外部 SPI Flash (W25Q64) 进行备份。
+ *          2. 支持将固件下载到外部 SPI Flash (W25Q64) 进行备份，按编号记录在固件目录中。
  *          3. 支持从外部 Flash 恢复或升级固件到内部 Flash。
  *          4. 管理 OTA 版本号及升级标志位 (保存在 EEPROM AT24Cxx 中)。
  *          5. 跳转至用户应用程序 (APP)。
+ *          6. 用硬件 CRC32 校验外部 Flash 固件与 A 区固件，校验失败不搬运、不跳转。
+ *          7. 接收压缩固件 (以 "HSZ" 压缩头开头时自动识别)，边接收边解压写入。
+ *          8. 接收差分补丁 (以 "DPT1" 补丁头开头时自动识别)，与基准固件合成新固件。
  * 
  */
 
@@ -17,6 +20,14 @@
 #include "24cxx.h"
 #include "stmflash.h"
 #include "norflash.h"
+#include "spi.h"
+#include "ota_stream.h"
+#include "ota_lzss.h"
+#include "ota_patch.h"
+#include "ota_catalog.h"
+#include "scratch.h"
+#include "crc16.h"
+#include "crc32.h"
 #include "main.h"
 
 /** 
@@ -29,18 +40,87 @@ load load_a;
  */
 extern UART_HandleTypeDef g_ota_uart_handle;
 
+/**
+ * @brief 后台页写入状态
+ */
+enum
+{
+    COMMIT_IDLE,    // 没有等待写入的页
+    COMMIT_ERASE,   // 擦除目标区域
+    COMMIT_PROGRAM, // 分段编程
+    COMMIT_WAIT,    // 等待外部 Flash 异步擦写完成
+};
+
+/**
+ * @brief 页登记结果 (bootloader_preerase_claim)
+ */
+enum
+{
+    PREERASE_READY, // 页已擦除，直接编程
+    PREERASE_ERASE, // 需要先擦除所在扇区
+    PREERASE_RANGE, // 页超出记录空间，不能写入
+};
+
+/**
+ * @brief 后台页写入控制块
+ * @details 接收满的一页交给后台写入，接收切换到另一个页缓冲区继续进行。
+ *          主循环在两帧数据之间调用 bootloader_commit_poll 分段擦写，
+ *          只有两个页缓冲区都满时接收才等待写入完成。
+ */
+typedef struct
+{
+    uint8_t state;   // 写入状态
+    uint8_t *buf;    // 等待写入的页缓冲区
+    uint32_t page;   // 页序号
+    uint16_t offset; // 已编程字节数
+    uint8_t error;   // 有页没能写入，本次下载需要中止
+}commit_cb;
+
+static commit_cb ota_commit;
+static uint32_t ota_nor_addr; // 外部 Flash 下载目标记录的固件数据地址
+
+/**
+ * @brief 外部 Flash 下载目标预擦除控制块
+ * @details 选择编号后立即排队擦除整个记录空间，擦除时间与主机连接前的 'C' 重发等待重叠；
+ *          clean 记录目标记录中已擦除且尚未写入的页，写入这些页时不再擦除。
+ */
+typedef struct
+{
+    uint32_t clean[OTA_PREERASE_WORDS];   // 第 n 页已擦除且未写入
+    uint32_t written[OTA_PREERASE_WORDS]; // 第 n 页已写入 (含已排队编程)
+    uint8_t pending;                      // 预擦除还在队列中
+}preerase_cb;
+
+static preerase_cb ota_preerase;
+static uint32_t ota_start_tick; // 收到第一段固件数据的时刻，用于统计下载耗时
+
 /* 内部函数声明 */
 static void bootloader_info(void);
+static uint8_t bootloader_page_write(uint32_t page, uint16_t len);
+static void bootloader_commit_start(uint32_t page);
+static void bootloader_commit_step(void);
+static void bootloader_commit_flush(void);
+static void bootloader_commit_done(void);
+static uint32_t bootloader_parse_id(uint8_t *data, uint16_t datalen);
+static uint8_t bootloader_preerase_start(uint32_t id);
+static void bootloader_preerase_done(void);
+static uint8_t bootloader_preerase_claim(uint32_t page);
+static void bootloader_session_open(void);
+static uint8_t bootloader_crc_valid(uint32_t bit);
+static void bootloader_crc_record(uint32_t bit, uint32_t crc);
+static uint32_t bootloader_crc_nor(uint32_t addr, uint32_t len);
+static uint8_t bootloader_image_crc(uint32_t id, uint32_t *crc);
 
 /**
  * @brief  Bootloader 串口数据处理状态机
  * @details 该函数是 Bootloader 的核心处理逻辑，通常在串口接收中断或轮询中调用。
  *          它根据 `boot_state_flag` 的状态处理不同的任务：
  *          - 空闲状态：解析菜单命令 ('1'~'7')。
- *          - IAP_XMODEMD_FLAG：处理 Xmodem 数据包接收与 Flash 写入。
+ *          - IAP_XMODEMD_FLAG：处理 Xmodem / Xmodem-1K 数据包接收与 Flash 写入。
+ *          - IAP_STREAM_FLAG：滑动窗口流式传输，数据交给 ota_stream 解析。
  *          - SET_VERSION_FLAG：解析并保存版本号字符串。
- *          - W25Q64_DL_FLAG：选择下载到外部 Flash 的块编号。
- *          - W25Q64_LOAD_FLAG：选择从外部 Flash 加载的块编号。
+ *          - W25Q64_DL_FLAG：选择下载到外部 Flash 的固件编号。
+ *          - W25Q64_LOAD_FLAG：选择从外部 Flash 加载的固件编号。
  * 
  * @param  data    指向接收到的数据缓冲区的指针
  * @param  datalen 接收到的数据长度（字节）
@@ -49,6 +129,9 @@ static void bootloader_info(void);
 void bootloader_event(uint8_t *data, uint16_t datalen)
 {
     int temp;
+    uint16_t paylen;
+    uint32_t len;
+    uint32_t id;
 
     // --- 状态：空闲模式 (等待菜单指令) ---
     if (boot_state_flag == 0)
@@ -58,8 +141,8 @@ void bootloader_event(uint8_t *data, uint16_t datalen)
                 // [1] 选择擦除 A 区程序
                 case '1' : {
                     printf("擦除A区\r\n");
-                    // 注意：这里硬编码了擦除100页(200KB)，建议根据实际芯片容量调整
-                    stmflash_erase(F103RC_A_SADDR, 100); 
+                    // 按 A 区实际占用的页数擦除
+                    bootloader_erase_a(0);
                     break;
                 }
                 // [2] 串口 IAP 下载 (Xmodem)
@@ -69,6 +152,7 @@ void bootloader_event(uint8_t *data, uint16_t datalen)
                     boot_state_flag |= (IAP_XMODEMC_FLAG | IAP_XMODEMD_FLAG);
                     updataA.xmodemTimer = 0;
                     updataA.xmodemNB = 0;
+                    updataA.xmodemLen = 0;
                     break;
                 }
                 // [3] 设置版本号
@@ -81,106 +165,112 @@ void bootloader_event(uint8_t *data, uint16_t datalen)
                 case '4' : {
                     at24cxx_read_otaflag();
                     printf("当前版本号:%s\r\n", OTA_Info.ota_ver);
+                    ota_catalog_info();
+                    printf("串口接收: 丢弃%ld帧, 帧队列最高占用%d/%d\r\n", ota_uart_cb.URxQueue.dropped,
+                        ota_uart_cb.URxQueue.highwater, OTA_RX_FRAMES);
+                    printf("共享缓冲区: 最高占用%ld/%d字节\r\n", scratch_highwater(), SCRATCH_SIZE);
                     bootloader_info();
                     break;
                 }
                 // [5] 向外部 Flash 下载程序
                 case '5' : {
-                    printf("向外部flash下载程序,输入要使用的编号(1~9)\r\n");
+                    printf("向外部flash下载程序,输入要使用的编号(1~%d)\r\n", OTA_CATALOG_IDS - 1);
                     boot_state_flag |= W25Q64_DL_FLAG;
                     break;
                 }
                 // [6] 使用外部 Flash 程序恢复/升级
                 case '6' : {
-                    printf("使用外部flash内的程序,输入要使用的编号(1~9)\r\n");
+                    printf("使用外部flash内的程序,输入要使用的编号(1~%d)\r\n", OTA_CATALOG_IDS - 1);
                     boot_state_flag |= W25Q64_LOAD_FLAG;
                     break;
                 }
                 // [7] 重启系统
                 case '7' : {
                     printf("重启.....");
-                    delay_ms(10);
+                    fflush(stdout);
+                    ota_uart_flush();
                     NVIC_SystemReset();
                     break;
                 }
                 default : break;
             }
         }
+        // [1 长度] 按上位机给出的字节数擦除 A 区，例如 "1 40960"
+        else if ((datalen > 2) && (data[0] == '1') && (data[1] == ' ')) {
+            len = 0;
+            for (temp = 2; (temp < datalen) && (data[temp] >= '0') && (data[temp] <= '9'); temp++) {
+                len = len * 10 + (data[temp] - '0');
+            }
+            if ((temp == 2) || (len > F103RC_A_PAGE_NUM * F103RC_PAGE_SIZE)) {
+                printf("长度错误\r\n");
+            }
+            else {
+                printf("擦除A区\r\n");
+                bootloader_erase_a(len);
+            }
+        }
+    }
+    // --- 状态：滑动窗口流式传输模式 ---
+    else if (boot_state_flag & IAP_STREAM_FLAG) {
+        ota_stream_input(data, datalen);
     }
     // --- 状态：Xmodem 数据传输模式 ---
     else if (boot_state_flag & IAP_XMODEMD_FLAG) {
-        // 处理 SOH 数据包 (133字节: 头1 + 包号1 + 反码1 + 数据128 + CRC2)
-        if ((datalen == 133) && (data[0] == 0x01)) {
+        // 收到流式传输帧头，切换到滑动窗口模式 (与 Xmodem 共用 'C' 握手与目标选择)
+        if (data[0] == STREAM_SYNC) {
+            boot_state_flag &= ~(IAP_XMODEMC_FLAG);
+            boot_state_flag |= IAP_STREAM_FLAG;
+            ota_stream_init();
+            ota_stream_input(data, datalen);
+            return;
+        }
+
+        // 处理 SOH 数据包 (133字节) 与 STX 数据包 (1029字节)，同一次传输中可混合出现
+        if (((datalen == XMODEM_SOH_LEN) && (data[0] == XMODEM_SOH)) ||
+            ((datalen == XMODEM_STX_LEN) && (data[0] == XMODEM_STX))) {
             boot_state_flag &= ~(IAP_XMODEMC_FLAG); // 收到数据，停止发送 'C' 请求
-            
+
+            paylen = (data[0] == XMODEM_SOH) ? XMODEM_SOH_DATA : XMODEM_STX_DATA;
+
             // 计算 CRC 校验
-            updataA.xmodemcrc = xmodem_crc16(&data[3], 128);
-            
-            // 校验通过 (高位在先)
-            if (updataA.xmodemcrc == (data[131] * 256 + data[132])) {
-                updataA.xmodemNB++; // 包计数增加
-                
-                // 将数据存入临时 Buffer，计算在 Page 中的偏移
-                // 注意：F103RC_PAGE_SIZE 通常为 2048 字节
-                memcpy(&updataA.updatabuff[(updataA.xmodemNB - 1) % (F103RC_PAGE_SIZE / 128) * 128], &data[3], 128);
-                
-                // 凑满一页数据，执行一次写入
-                if(updataA.xmodemNB % (F103RC_PAGE_SIZE / 128) == 0) {
-                    if (boot_state_flag & W25Q64_XMODEM_FLAG) {
-                        // 写入外部 Flash (W25Q64)
-                        norflash_write(updataA.updatabuff, 
-                            (updataA.w25q64_block_num * 64 * 1024) + ((updataA.xmodemNB / (F103RC_PAGE_SIZE / 128) - 1)  * F103RC_PAGE_SIZE), 
-                            F103RC_PAGE_SIZE);
+            updataA.xmodemcrc = xmodem_crc16(&data[3], paylen);
+
+            // 校验通过 (高位在先) 且包号与反码匹配
+            if ((updataA.xmodemcrc == (data[paylen + 3] * 256 + data[paylen + 4])) && (data[1] == (uint8_t)~data[2])) {
+                if (data[1] == (uint8_t)(updataA.xmodemNB + 1)) {
+                    updataA.xmodemNB++; // 包计数增加
+                    if (bootloader_receive(&data[3], paylen) == OTA_OK) {
+                        ota_uart_send_byte(XMODEM_ACK); // 发送 ACK
                     }
                     else {
-                        // 写入内部 Flash
-                        stmflash_write(F103RC_A_SADDR + (updataA.xmodemNB / (F103RC_PAGE_SIZE / 128) - 1) * F103RC_PAGE_SIZE, 
-                            (uint16_t *)updataA.updatabuff, 
-                            F103RC_PAGE_SIZE / 2);
+                        // 解压或补丁失败、固件超出目标大小、写入失败，发送 CAN 取消传输
+                        ota_uart_send_byte(XMODEM_CAN);
+                        ota_uart_send_byte(XMODEM_CAN);
+                        bootloader_download_abort();
                     }
                 }
-                printf("\x06\r\n"); // 发送 ACK
+                else if (data[1] == (uint8_t)updataA.xmodemNB) {
+                    // 重发的上一包 (ACK 丢失)，数据已写入，直接应答
+                    ota_uart_send_byte(XMODEM_ACK); // 发送 ACK
+                }
+                else {
+                    ota_uart_send_byte(XMODEM_NAK); // 包号不连续，发送 NAK
+                }
             }
             else {
-                printf("\x15\r\n"); // 校验失败，发送 NAK
+                ota_uart_send_byte(XMODEM_NAK); // 校验失败，发送 NAK
             }
         }
 
         // 处理 EOT 结束信号 (0x04)
-        if ((datalen == 1) && (data[0] == 0x04)) {
-            printf("\x06\r\n"); // 发送 ACK
-            
-            // 处理不足一页的剩余数据
-            if(updataA.xmodemNB % (F103RC_PAGE_SIZE / 128) != 0) {
-                if (boot_state_flag & W25Q64_XMODEM_FLAG)
-                {
-                    norflash_write(updataA.updatabuff, 
-                        (updataA.w25q64_block_num * 64 * 1024) + (updataA.xmodemNB / (F103RC_PAGE_SIZE / 128)  * F103RC_PAGE_SIZE), 
-                        F103RC_PAGE_SIZE);
-                }
-                else
-                {
-                    stmflash_write(F103RC_A_SADDR + (updataA.xmodemNB / (F103RC_PAGE_SIZE / 128)) * F103RC_PAGE_SIZE, 
-                        (uint16_t *)updataA.updatabuff, 
-                        updataA.xmodemNB % (F103RC_PAGE_SIZE / 128) * 128 / 2);
-                }
-            }
-            
-            // 传输结束，清除标志位并执行后续操作
-            boot_state_flag &= ~(IAP_XMODEMD_FLAG);
-            
-            if (boot_state_flag & W25Q64_XMODEM_FLAG) {
-                // 如果是下载到外部 Flash，记录长度信息到 EEPROM
-                boot_state_flag &= ~(W25Q64_XMODEM_FLAG);
-                OTA_Info.firlen[updataA.w25q64_block_num] = updataA.xmodemNB * 128;
-                at24cxx_write_otainfo();
-                delay_ms(100);
-                bootloader_info();
+        if ((datalen == 1) && (data[0] == XMODEM_EOT)) {
+            ota_uart_send_byte(XMODEM_ACK); // 发送 ACK
+            if (bootloader_receive_complete()) {
+                bootloader_download_finish();
             }
             else {
-                // 如果是直接更新 APP，完成后重启
-                delay_ms(10);
-                NVIC_SystemReset();
+                printf("压缩或补丁数据不完整\r\n");
+                bootloader_download_abort();
             }
         }
     }
@@ -204,46 +294,610 @@ void bootloader_event(uint8_t *data, uint16_t datalen)
             printf("版本号长度错误,请重新设置\r\n");
         }
     }
-    // --- 状态：准备下载到外部 Flash (选择块) ---
+    // --- 状态：准备下载到外部 Flash (选择编号) ---
     else if (boot_state_flag & W25Q64_DL_FLAG) {
-        if (datalen == 1) {
-            if (data[0] >= '1' && data[0] <= '9') {
-                updataA.w25q64_block_num = data[0] - '0';
-                // 状态转移：进入 Xmodem 接收 + 外部 Flash 写模式
-                boot_state_flag |= (IAP_XMODEMC_FLAG | IAP_XMODEMD_FLAG | W25Q64_XMODEM_FLAG);
-                updataA.xmodemTimer = 0;
-                updataA.xmodemNB = 0;
-                OTA_Info.firlen[updataA.w25q64_block_num] = 0;
-                printf("通过Xmodem协议:向外部flash第%d块下载程序,请使用bin格式文件\r\n", updataA.w25q64_block_num);
-                boot_state_flag &= ~(W25Q64_DL_FLAG);
-            }
-            else {
-                printf("编号错误\r\n");
-            }
+        id = bootloader_parse_id(data, datalen);
+        if (id == 0) {
+            printf("编号错误\r\n");
+        }
+        else if (bootloader_preerase_start(id) == 0) {
+            printf("外部flash空间不足\r\n");
+            boot_state_flag &= ~(W25Q64_DL_FLAG);
+            bootloader_info();
         }
         else {
-            printf("数据长度错误\r\n");
+            updataA.w25q64_block_num = id;
+            // 状态转移：进入 Xmodem 接收 + 外部 Flash 写模式
+            boot_state_flag |= (IAP_XMODEMC_FLAG | IAP_XMODEMD_FLAG | W25Q64_XMODEM_FLAG);
+            updataA.xmodemTimer = 0;
+            updataA.xmodemNB = 0;
+            updataA.xmodemLen = 0;
+            printf("通过Xmodem协议:向外部flash第%ld号下载程序,请使用bin格式文件\r\n", id);
+            boot_state_flag &= ~(W25Q64_DL_FLAG);
         }
     }
-    // --- 状态：准备从外部 Flash 加载 (选择块) ---
+    // --- 状态：准备从外部 Flash 加载 (选择编号) ---
     else if (boot_state_flag & W25Q64_LOAD_FLAG) {
-        if (datalen == 1) {
-            if (data[0] >= '1' && data[0] <= '9') {
-                updataA.w25q64_block_num = data[0] - '0';
-                // 状态转移：设置更新标志位，主循环将检测此标志进行搬运
-                boot_state_flag |= UPDATA_A_FLAG;
-                boot_state_flag &= ~(W25Q64_LOAD_FLAG);
+        id = bootloader_parse_id(data, datalen);
+        if (id == 0) {
+            printf("编号错误\r\n");
+        }
+        else if (ota_catalog_find(id) == NULL) {
+            printf("外部flash第%ld号没有固件\r\n", id);
+        }
+        else {
+            updataA.w25q64_block_num = id;
+            // 状态转移：设置更新标志位，主循环将检测此标志进行搬运
+            boot_state_flag |= UPDATA_A_FLAG;
+            boot_state_flag &= ~(W25Q64_LOAD_FLAG);
+        }
+    }
+}
+
+/**
+ * @brief  解析上位机输入的固件编号
+ * @param  data    输入数据
+ * @param  datalen 数据长度
+ * @return uint32_t 编号 (1 ~ OTA_CATALOG_IDS-1)，0 表示格式错误或超出范围
+ */
+static uint32_t bootloader_parse_id(uint8_t *data, uint16_t datalen)
+{
+    uint32_t id = 0;
+    uint16_t i;
+
+    if ((datalen == 0) || (datalen > 2)) {
+        return 0;
+    }
+    for (i = 0; i < datalen; i++) {
+        if ((data[i] < '0') || (data[i] > '9')) {
+            return 0;
+        }
+        id = id * 10 + (data[i] - '0');
+    }
+    return (id < OTA_CATALOG_IDS) ? id : 0;
+}
+
+
+/**
+ * @brief  将页缓冲区写入目标存储器
+ * @details 根据 W25Q64_XMODEM_FLAG 选择写入外部 Flash 固件目录中的新记录或内部 Flash A 区。
+ *
+ * @param  page 页序号 (从 0 开始，单位 F103RC_PAGE_SIZE)
+ * @param  len  本页有效字节数
+ * @retval 0 成功
+ * @retval 1 页超出记录空间或 A 区写入会话已失败，数据没有写入
+ */
+static uint8_t bootloader_page_write(uint32_t page, uint16_t len)
+{
+    uint32_t addr;
+    uint8_t erase;
+
+    if (boot_state_flag & W25Q64_XMODEM_FLAG) {
+        // 写入外部 Flash (W25Q64)，整页写入，不足部分保持缓冲区内容。
+        // 与后台写入相同：页已预擦除时直接编程，否则擦除所在扇区，不需要读改写缓存
+        addr = ota_nor_addr + page * F103RC_PAGE_SIZE;
+        erase = bootloader_preerase_claim(page);
+        if (erase == PREERASE_RANGE) {
+            return 1;
+        }
+        if (erase == PREERASE_ERASE) {
+            norflash_erase_range(addr & ~4095UL, 4096);
+        }
+        norflash_write_nocheck(updataA.updatabuff, addr, F103RC_PAGE_SIZE);
+        return 0;
+    }
+    // 写入内部 Flash，顺序写入会话，奇数长度的最后1字节在会话结束时以 0xFF 补齐
+    bootloader_session_open();
+    return stmflash_session_write(updataA.updatabuff, len);
+}
+
+/**
+ * @brief  打开 A 区写入会话
+ * @details 第一次写入 A 区时开始会话，之后 A 区按写指针提前擦除、直接编程，
+ *          下载结束或中止时关闭会话并上锁。
+ * @return None
+ */
+static void bootloader_session_open(void)
+{
+    if (!stmflash_session_active()) {
+        stmflash_session_begin(F103RC_A_SADDR, bootloader_target_size());
+        stmflash_perf_reset();
+    }
+}
+
+/**
+ * @brief  将满页交给后台写入
+ * @details 上一页还没有写完时 (两个页缓冲区都满) 先等待其写完。当前页缓冲区
+ *          交给后台，接收切换到另一个页缓冲区。
+ *
+ * @param  page 页序号
+ * @return None
+ */
+static void bootloader_commit_start(uint32_t page)
+{
+    bootloader_commit_flush();
+
+    ota_commit.buf = updataA.updatabuff;
+    ota_commit.page = page;
+    ota_commit.offset = 0;
+    ota_commit.state = COMMIT_ERASE;
+    updataA.updatabuff = (updataA.updatabuff == updataA.pagebuff[0]) ? updataA.pagebuff[1] : updataA.pagebuff[0];
+}
+
+/**
+ * @brief  执行一步后台写入
+ * @details 外部 Flash：目标记录在选择编号时已开始预擦除，页已擦除 (或预擦除还在队列中) 时
+ *          直接把整页排队异步编程；预擦除没能排队时先排队擦除所在扇区。之后只等待完成
+ *          回调，擦写期间主循环照常处理串口数据。
+ *          内部 Flash：不单独擦除，由写入会话与现有内容比较，内容相同的页跳过，无法直接
+ *          编程时才擦除，每步编程 OTA_COMMIT_CHUNK 字节。
+ *          页没能写入时记录错误并结束这一页，由 bootloader_receive 中止下载。
+ * @return None
+ */
+static void bootloader_commit_step(void)
+{
+    uint32_t addr;
+    uint8_t erase;
+
+    if (boot_state_flag & W25Q64_XMODEM_FLAG) {
+        addr = ota_nor_addr + ota_commit.page * F103RC_PAGE_SIZE;
+    }
+    else {
+        addr = F103RC_A_SADDR + ota_commit.page * F103RC_PAGE_SIZE;
+    }
+
+    switch (ota_commit.state) {
+        case COMMIT_ERASE : {
+            if (boot_state_flag & W25Q64_XMODEM_FLAG) {
+                erase = bootloader_preerase_claim(ota_commit.page);
+                if (erase == PREERASE_RANGE) {
+                    ota_commit.error = 1;
+                    ota_commit.state = COMMIT_IDLE;
+                    break;
+                }
+                // 队列满时推进队列，等最早的操作完成让出位置再排队，擦除与编程都不能丢
+                if (erase == PREERASE_ERASE) {
+                    while (norflash_async_erase(addr & ~4095UL, 4096, NULL)) {
+                        norflash_async_poll();
+                    }
+                }
+                ota_commit.state = COMMIT_WAIT;
+                while (norflash_async_program(ota_commit.buf, addr, F103RC_PAGE_SIZE, bootloader_commit_done)) {
+                    norflash_async_poll();
+                }
+                break;
             }
-            else {
-                printf("编号错误\r\n");
+            bootloader_session_open();
+            ota_commit.state = COMMIT_PROGRAM;
+            break;
+        }
+        case COMMIT_PROGRAM : {
+            if (stmflash_session_write(&ota_commit.buf[ota_commit.offset], OTA_COMMIT_CHUNK)) {
+                ota_commit.error = 1;
+                ota_commit.state = COMMIT_IDLE;
+                break;
             }
+            ota_commit.offset += OTA_COMMIT_CHUNK;
+            if (ota_commit.offset >= F103RC_PAGE_SIZE) {
+                ota_commit.state = COMMIT_IDLE;
+            }
+            break;
         }
-        else {
-            printf("数据长度错误\r\n");
+        case COMMIT_WAIT : {
+            norflash_async_poll();
+            break;
+        }
+        default : break;
+    }
+}
+
+/**
+ * @brief  外部 Flash 异步编程完成回调
+ * @return None
+ */
+static void bootloader_commit_done(void)
+{
+    ota_commit.state = COMMIT_IDLE;
+}
+
+/**
+ * @brief  在固件目录中开始新记录并预擦除
+ * @details 按 A 区大小分配记录空间，整个区域排队异步擦除。
+ * @param  id 固件编号
+ * @retval 1 成功
+ * @retval 0 空间不足
+ */
+static uint8_t bootloader_preerase_start(uint32_t id)
+{
+    // 开始新记录前会等待之前的擦写完成，之前的预擦除回调不会再到来
+    ota_nor_addr = ota_catalog_begin(id, bootloader_target_size(), bootloader_preerase_done);
+    if (ota_nor_addr == 0) {
+        return 0;
+    }
+    memset(&ota_preerase, 0, sizeof(ota_preerase));
+    ota_preerase.pending = 1;
+    return 1;
+}
+
+/**
+ * @brief  预擦除完成回调
+ * @details 预擦除全部完成后，还没有写入的页记为已擦除。
+ * @return None
+ */
+static void bootloader_preerase_done(void)
+{
+    uint32_t i;
+
+    ota_preerase.pending = 0;
+    for (i = 0; i < OTA_PREERASE_WORDS; i++) {
+        ota_preerase.clean[i] = ~ota_preerase.written[i];
+    }
+}
+
+/**
+ * @brief  登记即将写入的页
+ * @details 页已擦除或预擦除还在队列中 (队列按顺序执行，编程一定在擦除之后) 时不需要擦除；
+ *          否则由调用者擦除页所在的 4KB 扇区，扇区内另一页未写入时一并记为已擦除。
+ *
+ * @param  page 页序号 (记录内，从 0 开始)
+ * @return uint8_t PREERASE_READY / PREERASE_ERASE / PREERASE_RANGE (超出位图，即超出记录空间)
+ */
+static uint8_t bootloader_preerase_claim(uint32_t page)
+{
+    uint32_t word = page / 32;
+    uint32_t bit = 1UL << (page % 32);
+    uint8_t erase;
+
+    if (page >= OTA_PREERASE_WORDS * 32) {
+        return PREERASE_RANGE;
+    }
+    erase = (!ota_preerase.pending && !(ota_preerase.clean[word] & bit)) ? PREERASE_ERASE : PREERASE_READY;
+
+    // 扇区的两页在同一个字中 (page 为偶数时对齐)
+    if (erase == PREERASE_ERASE) {
+        ota_preerase.clean[word] |= (3UL << ((page % 32) & ~1UL)) & ~ota_preerase.written[word];
+    }
+    ota_preerase.clean[word] &= ~bit;
+    ota_preerase.written[word] |= bit;
+    return erase;
+}
+
+/**
+ * @brief  等待后台写入完成
+ * @return None
+ */
+static void bootloader_commit_flush(void)
+{
+    while (ota_commit.state != COMMIT_IDLE) {
+        bootloader_commit_step();
+    }
+}
+
+/**
+ * @brief  是否有后台写入步骤需要主循环执行
+ * @details 外部 Flash 异步擦写进行中不算，由软件定时器推进。
+ * @retval 1 有
+ * @retval 0 没有
+ */
+uint8_t bootloader_commit_busy(void)
+{
+    // 等待外部 Flash 时由 1ms 软件定时器查询，主循环可以休眠
+    return (ota_commit.state != COMMIT_IDLE) && (ota_commit.state != COMMIT_WAIT);
+}
+
+/**
+ * @brief  后台写入调度
+ * @details 在主循环中调用，串口接收环形缓冲区中没有待处理的数据时连续执行写入步骤，
+ *          一旦有新数据到达立即返回，先处理数据并发送应答，使 flash 擦写时间与
+ *          主机发送下一包的时间重叠。
+ * @return None
+ */
+void bootloader_commit_poll(void)
+{
+    while ((ota_commit.state != COMMIT_IDLE) && (ota_commit.state != COMMIT_WAIT) && !ota_uart_rx_pending()) {
+        bootloader_commit_step();
+    }
+}
+
+/**
+ * @brief  将接收到的固件数据拼接到页缓冲区
+ * @details Xmodem SOH(128字节)/STX(1024字节) 负载与流式传输数据帧都按字节偏移
+ *          拼入 updatabuff，凑满一页交给后台写入并切换到另一个页缓冲区；数据跨页时，
+ *          前半段先补满当前页，剩余部分放到下一页开头。
+ *
+ * @param  data 固件数据
+ * @param  len  数据长度
+ * @return None
+ */
+void bootloader_store(uint8_t *data, uint16_t len)
+{
+    uint16_t offset;
+    uint16_t count;
+
+    while (len) {
+        offset = updataA.xmodemLen % F103RC_PAGE_SIZE;
+        count = F103RC_PAGE_SIZE - offset;
+        if (count > len) {
+            count = len;
+        }
+
+        memcpy(&updataA.updatabuff[offset], data, count);
+        updataA.xmodemLen += count;
+        data += count;
+        len -= count;
+
+        // 凑满一页数据，交给后台写入
+        if (updataA.xmodemLen % F103RC_PAGE_SIZE == 0) {
+            bootloader_commit_start(updataA.xmodemLen / F103RC_PAGE_SIZE - 1);
+        }
+    }
+}
+
+/**
+ * @brief  接收一段固件数据
+ * @details Xmodem 与流式传输按顺序交付的负载都经过这里。传输的第一段数据以
+ *          压缩头开头时进入解压模式，之后的数据由 ota_lzss 解压后再交给
+ *          bootloader_unpacked；否则直接交给 bootloader_unpacked。
+ *          后台写入有页没能写入时 (包括上一段数据的页) 返回 OTA_ERR_FLASH。
+ *
+ * @param  data 固件数据
+ * @param  len  数据长度
+ * @return uint8_t OTA_OK 表示正常，其余为错误码
+ */
+uint8_t bootloader_receive(uint8_t *data, uint16_t len)
+{
+    uint8_t err;
+
+    if (!(boot_state_flag & (IAP_LZSS_FLAG | IAP_PATCH_FLAG)) && (updataA.xmodemLen == 0)) {
+        ota_start_tick = HAL_GetTick();
+        ota_commit.error = 0;
+    }
+    if (!(boot_state_flag & (IAP_LZSS_FLAG | IAP_PATCH_FLAG)) && (updataA.xmodemLen == 0) && ota_lzss_detect(data, len)) {
+        boot_state_flag |= IAP_LZSS_FLAG;
+        ota_lzss_init(bootloader_target_size());
+    }
+
+    if (boot_state_flag & IAP_LZSS_FLAG) {
+        err = ota_lzss_input(data, len);
+    }
+    else {
+        err = bootloader_unpacked(data, len);
+    }
+    if ((err == OTA_OK) && ota_commit.error) {
+        err = OTA_ERR_FLASH;
+    }
+    return err;
+}
+
+/**
+ * @brief  处理解压后的固件数据
+ * @details 解压后的第一段数据以补丁头开头时进入差分模式，之后的数据由 ota_patch
+ *          与基准固件合成后再交给 bootloader_store；否则直接写入。直接写入的数据
+ *          (Xmodem 不带长度) 超出下载目标大小时返回 OTA_ERR_SIZE，取消传输，
+ *          不写入目标区域之外。
+ *
+ * @param  data 固件数据
+ * @param  len  数据长度
+ * @return uint8_t OTA_OK 表示正常，其余为错误码
+ */
+uint8_t bootloader_unpacked(uint8_t *data, uint16_t len)
+{
+    if (!(boot_state_flag & IAP_PATCH_FLAG) && (updataA.xmodemLen == 0) && ota_patch_detect(data, len)) {
+        boot_state_flag |= IAP_PATCH_FLAG;
+        ota_patch_init(bootloader_target_size());
+    }
+
+    if (boot_state_flag & IAP_PATCH_FLAG) {
+        return ota_patch_input(data, len);
+    }
+    if (updataA.xmodemLen + len > bootloader_target_size()) {
+        return OTA_ERR_SIZE;
+    }
+    bootloader_store(data, len);
+    return OTA_OK;
+}
+
+/**
+ * @brief  判断接收的固件是否完整
+ * @details 完整固件由传输协议保证完整；压缩固件必须解压出压缩头记录的原始长度，
+ *          差分补丁必须输出补丁头记录的新固件长度。
+ * @retval 1 完整
+ * @retval 0 不完整
+ */
+uint8_t bootloader_receive_complete(void)
+{
+    return (!(boot_state_flag & IAP_LZSS_FLAG) || ota_lzss_done()) &&
+           (!(boot_state_flag & IAP_PATCH_FLAG) || ota_patch_done());
+}
+
+/**
+ * @brief  查找差分补丁的基准固件
+ * @details 依次检查 A 区、外部 Flash 0 号下载区与固件目录中的各编号，长度相同且
+ *          CRC32 一致的即为基准固件。下载到外部 Flash 时写入的是新记录，同一编号
+ *          原有的固件也可以作为基准。在补丁头到达时调用，此时 updatabuff 中还没有
+ *          待写入的数据，可以用作外部 Flash 读缓冲。
+ *
+ * @param  len  旧固件长度
+ * @param  crc  旧固件 CRC32
+ * @param  base 返回基准固件位置 (PATCH_BASE_A 或外部 Flash 地址)
+ * @retval 1 找到
+ * @retval 0 未找到
+ */
+uint8_t bootloader_find_base(uint32_t len, uint32_t crc, uint32_t *base)
+{
+    uint32_t id;
+    uint32_t addr;
+    uint32_t size;
+
+    if ((boot_state_flag & W25Q64_XMODEM_FLAG) && (len <= F103RC_A_PAGE_NUM * F103RC_PAGE_SIZE) &&
+        (crc32_hw_calc((uint8_t *)F103RC_A_SADDR, len) == crc)) {
+        printf("差分升级: 基准固件为A区\r\n");
+        *base = PATCH_BASE_A;
+        return 1;
+    }
+
+    for (id = 0; id < OTA_CATALOG_IDS; id++) {
+        if (!bootloader_image(id, &addr, &size) || (size != len)) {
+            continue;
+        }
+        if (bootloader_crc_nor(addr, len) == crc) {
+            printf("差分升级: 基准固件为外部flash第%ld号\r\n", id);
+            *base = addr;
+            return 1;
+        }
+    }
+
+    printf("差分升级: 找不到基准固件 (长度%ld, CRC32 0x%08lX)\r\n", len, crc);
+    return 0;
+}
+
+/**
+ * @brief  当前下载目标区域的大小
+ * @details 外部 Flash 的固件记录按 A 区大小分配，两种目标相同。
+ * @return uint32_t 内部 Flash A 区大小
+ */
+uint32_t bootloader_target_size(void)
+{
+    return F103RC_A_PAGE_NUM * F103RC_PAGE_SIZE;
+}
+
+/**
+ * @brief  擦除 A 区
+ * @details 擦除范围取 EEPROM 记录的 A 区固件长度、从 A 区末尾向前扫描到的最后一个非空页
+ *          以及 len 三者中最大的一个，按 OTA_ERASE_BATCH 页一批擦除并报告进度。
+ *          擦除后清除 A 区 CRC 记录。
+ * @param  len 上位机给出的固件字节数，0 表示只按记录长度与扫描结果
+ * @return None
+ */
+void bootloader_erase_a(uint32_t len)
+{
+    uint32_t pages;
+    uint32_t done;
+    uint32_t n;
+
+    pages = (len + F103RC_PAGE_SIZE - 1) / F103RC_PAGE_SIZE;
+    if (bootloader_crc_valid(OTA_CRC_A_BIT) && (OTA_Info.a_len <= F103RC_A_PAGE_NUM * F103RC_PAGE_SIZE)) {
+        n = (OTA_Info.a_len + F103RC_PAGE_SIZE - 1) / F103RC_PAGE_SIZE;
+        if (n > pages) {
+            pages = n;
         }
     }
+    n = stmflash_used_pages(F103RC_A_SADDR, F103RC_A_PAGE_NUM);
+    if (n > pages) {
+        pages = n;
+    }
+
+    if (pages == 0) {
+        printf("A区已为空\r\n");
+    }
+    for (done = 0; done < pages; done += n) {
+        n = (pages - done > OTA_ERASE_BATCH) ? OTA_ERASE_BATCH : (pages - done);
+        stmflash_erase(F103RC_A_SADDR + done * F103RC_PAGE_SIZE, n);
+        printf("擦除A区: %ld/%ld页\r\n", done + n, pages);
+    }
+
+    // A区已无固件，清除 CRC 记录
+    if (bootloader_crc_valid(OTA_CRC_A_BIT)) {
+        OTA_Info.crc_mask &= ~(1UL << OTA_CRC_A_BIT);
+        at24cxx_write_otainfo();
+    }
+}
+
+/**
+ * @brief  固件下载结束处理
+ * @details 等待后台写入完成后写入不足一页的剩余数据，清除传输标志位。从目标存储器读回已写入的固件
+ *          计算 CRC32，与长度一起记录到 EEPROM。下载到外部 Flash 时返回命令行；
+ *          直接更新 A 区时复位运行新程序 (启动时按记录的 CRC 校验 A 区)。
+ *          有页没能写入时按中止处理，不记录长度与 CRC (读回的 CRC 来自写坏的数据，不能作为校验依据)。
+ * @return None
+ */
+void bootloader_download_finish(void)
+{
+    uint32_t crc;
+    uint32_t rate;
+    uint32_t halfwords;
+    uint32_t skipped;
+    uint32_t erased;
+    uint32_t programmed;
+    uint32_t patch = boot_state_flag & IAP_PATCH_FLAG;
+
+    // 等待后台写入完成，再处理不足一页的剩余数据
+    bootloader_commit_flush();
+    if ((updataA.xmodemLen % F103RC_PAGE_SIZE != 0) &&
+        bootloader_page_write(updataA.xmodemLen / F103RC_PAGE_SIZE, updataA.xmodemLen % F103RC_PAGE_SIZE)) {
+        ota_commit.error = 1;
+    }
+    if (stmflash_session_end()) {
+        ota_commit.error = 1;
+    }
+    if (ota_commit.error) {
+        printf("固件写入失败\r\n");
+        bootloader_download_abort();
+        return;
+    }
+    scratch_return(SCRATCH_LZSS);
+    scratch_return(SCRATCH_PATCH);
+    scratch_return(SCRATCH_STREAM);
+
+    // 传输结束，清除标志位并执行后续操作
+    boot_state_flag &= ~(IAP_XMODEMC_FLAG | IAP_XMODEMD_FLAG | IAP_STREAM_FLAG | IAP_LZSS_FLAG | IAP_PATCH_FLAG);
+
+    if (boot_state_flag & W25Q64_XMODEM_FLAG) {
+        crc = bootloader_crc_nor(ota_nor_addr, updataA.xmodemLen);
+    }
+    else {
+        crc = crc32_hw_calc((uint8_t *)F103RC_A_SADDR, updataA.xmodemLen);
+    }
+
+    // 差分结果与补丁头不一致时记录补丁头中的 CRC，搬运前或启动时的校验会拒绝该固件
+    if (patch && (crc != ota_patch_crc())) {
+        printf("差分升级结果校验失败: CRC32 0x%08lX, 应为 0x%08lX\r\n", crc, ota_patch_crc());
+        crc = ota_patch_crc();
+    }
+
+    if (boot_state_flag & W25Q64_XMODEM_FLAG) {
+        // 如果是下载到外部 Flash，在记录头中写入长度与 CRC，记录生效
+        boot_state_flag &= ~(W25Q64_XMODEM_FLAG);
+        ota_catalog_end(updataA.xmodemLen, crc);
+        printf("外部flash第%lu号: %lu字节, CRC32 0x%08lX\r\n", updataA.w25q64_block_num, updataA.xmodemLen, crc);
+        printf("外部flash编程: %lu字节, 下载耗时%ldms\r\n", norflash_programmed(), HAL_GetTick() - ota_start_tick);
+        bootloader_info();
+    }
+    else {
+        // 如果是直接更新 APP，记录 A 区长度与 CRC 后重启
+        OTA_Info.a_len = updataA.xmodemLen;
+        bootloader_crc_record(OTA_CRC_A_BIT, crc);
+        at24cxx_write_otainfo();
+        rate = stmflash_perf_rate(&halfwords);
+        stmflash_session_stat(&skipped, &erased, &programmed);
+        printf("内部flash编程: %lu字节, %lu半字/秒\r\n", halfwords * 2, rate);
+        printf("页: 跳过%lu, 擦除%lu, 编程%lu\r\n", skipped, erased, programmed);
+        ota_uart_flush();
+        NVIC_SystemReset();
+    }
 }
 
+/**
+ * @brief  固件下载中止处理
+ * @details 等待后台写入完成，清除全部传输标志位并返回命令行，已写入的数据保持原样。
+ * @return None
+ */
+void bootloader_download_abort(void)
+{
+    bootloader_commit_flush();
+    stmflash_session_end();
+    scratch_return(SCRATCH_LZSS);
+    scratch_return(SCRATCH_PATCH);
+    scratch_return(SCRATCH_STREAM);
+    norflash_programmed();
+    if (boot_state_flag & W25Q64_XMODEM_FLAG) {
+        ota_catalog_cancel();
+    }
+    boot_state_flag &= ~(IAP_XMODEMC_FLAG | IAP_XMODEMD_FLAG | IAP_STREAM_FLAG | IAP_LZSS_FLAG | IAP_PATCH_FLAG | W25Q64_XMODEM_FLAG);
+    ota_commit.error = 0;
+    printf("传输中止\r\n");
+    bootloader_info();
+}
 
 /**
  * @brief  打印 Bootloader 命令行菜单
@@ -253,7 +907,7 @@ void bootloader_event(uint8_t *data, uint16_t datalen)
 static void bootloader_info(void)
 {
     printf("\r\n");
-    printf("[1]擦除A区\r\n");
+    printf("[1]擦除A区 (可跟字节数: 1 长度)\r\n");
     printf("[2]串口IAP下载A区程序\r\n");
     printf("[3]设置OTA版本号\r\n");
     printf("[4]查询OTA版本号\r\n");
@@ -285,17 +939,25 @@ uint8_t bootloader_enter(uint8_t timeout)
 
 /**
  * @brief  跳转到用户 APP 应用程序
- * @details 检查指定地址的栈顶指针是否合法，如果合法则复位 MSP 并跳转。
+ * @details 检查指定地址的栈顶指针是否合法，如果合法则关闭 Bootloader 使用的外设
+ *          (串口与循环接收 DMA、SPI1/CRC 的 DMA 通道、SysTick 软件定时器)，
+ *          清除挂起的中断，再复位 MSP 并跳转，APP 不会收到 Bootloader 留下的中断或 DMA 写入。
  * 
  * @param  addr APP 程序的起始地址 (如 F103RC_A_SADDR)
  * @return None (如果跳转成功，不会返回)
- * @note   建议在跳转前关闭全局中断 (__disable_irq()) 以防止 HardFault。
  */
 static void load_app(uint32_t addr)
 {
     // 判断程序起始地址是否有合法的堆栈指针地址 (检查是否在 RAM 范围内：0x20000000)
     // 0X2FFE0000 掩码适用于 64KB~128KB RAM 的 F103RC/ZE 等型号
     if (((*(__IO uint32_t *)addr) & 0X2FFE0000) == 0x20000000) {
+        ota_uart_flush();                              // 发完缓冲区中的日志，避免 APP 接管串口时 DMA 仍在发送
+        ota_uart_deinit();                             // 停止收发 DMA，关闭串口与 DMA 中断
+        spi1_dma_deinit();
+        crc32_hw_deinit();
+        SysTick->CTRL = 0;                             // 停止 SysTick (软件定时器)，清除挂起
+        SysTick->VAL = 0;
+        SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk;
         load_a = (load)(*(__IO uint32_t *)(addr + 4)); // 获取 APP 区复位中断向量地址
          __set_MSP(*(__IO uint32_t *)addr);            // 初始化堆栈指针 (MSP)
         load_a();                                      // 跳转至 APP
@@ -328,8 +990,8 @@ void bootloader_brance(void)
             boot_state_flag |= UPDATA_A_FLAG;
             updataA.w25q64_block_num = 0;
         }
-        // 否则直接跳转 APP 区
-        else {
+        // 否则校验 A 区后跳转 APP 区
+        else if (bootloader_check_a()) {
             printf("跳转APP程序...\r\n");
             load_app(F103RC_A_SADDR);
         }
@@ -341,7 +1003,7 @@ void bootloader_brance(void)
 
 /**
  * @brief  计算 XMODEM 协议的 CRC16 校验值
- * @details 使用标准 CRC-16-CCITT 多项式 (0x1021)。
+ * @details 使用标准 CRC-16-CCITT 多项式 (0x1021)，由 CRC 模块查表计算。
  * 
  * @param  pdata 指向要计算的数据缓冲区的指针
  * @param  len   数据长度
@@ -349,20 +1011,204 @@ void bootloader_brance(void)
  */
 uint16_t xmodem_crc16(uint8_t *pdata, uint32_t len)
 {
-    uint8_t i;
-    uint16_t crcinit = 0x0000;
-    uint16_t crcpoly = 0x1021;
+    return crc16_calc(pdata, len);
+}
 
-    while (len--) {
-        crcinit  = crcinit ^ (*pdata++ << 8);
-        for (i = 0; i < 8; i++) {
-            if (crcinit & 0x8000) {
-                crcinit = (crcinit << 1) ^ crcpoly;
-            }
-            else {
-                crcinit <<= 1;
-            }
-        }
+/**
+ * @brief  判断 EEPROM 中的 CRC 记录是否有效
+ * @details 旧版本写入的 OTA_Info 没有 CRC 字段，crc_flag 不等于 OTA_CRC_FLAG 时
+ *          视为全部未记录，对应的固件跳过校验。
+ *
+ * @param  bit 记录位 (0: 外部flash 0号下载区, OTA_CRC_A_BIT: A区)
+ * @retval 1 已记录
+ * @retval 0 未记录
+ */
+static uint8_t bootloader_crc_valid(uint32_t bit)
+{
+    return (OTA_Info.crc_flag == OTA_CRC_FLAG) && (OTA_Info.crc_mask & (1UL << bit));
+}
+
+/**
+ * @brief  记录一个 CRC 值 (只修改 OTA_Info，由调用者写入 EEPROM)
+ * @param  bit 记录位 (0: 外部flash 0号下载区, OTA_CRC_A_BIT: A区)
+ * @param  crc CRC32
+ * @return None
+ */
+static void bootloader_crc_record(uint32_t bit, uint32_t crc)
+{
+    if (OTA_Info.crc_flag != OTA_CRC_FLAG) {
+        OTA_Info.crc_flag = OTA_CRC_FLAG;
+        OTA_Info.crc_mask = 0;
+    }
+    if (bit == OTA_CRC_A_BIT) {
+        OTA_Info.a_crc = crc;
+    }
+    else {
+        OTA_Info.fircrc[bit] = crc;
+    }
+    OTA_Info.crc_mask |= 1UL << bit;
+}
+
+/**
+ * @brief  计算外部 Flash 中一段数据的 CRC32
+ * @details 以 updatabuff 为中转，每次读取一页交给硬件 CRC (DMA 输入)。
+ *
+ * @param  addr 外部 Flash 地址
+ * @param  len  数据长度 (字节)
+ * @return uint32_t CRC32
+ */
+static uint32_t bootloader_crc_nor(uint32_t addr, uint32_t len)
+{
+    uint32_t count;
+
+    crc32_hw_reset();
+    while (len) {
+        count = (len > F103RC_PAGE_SIZE) ? F103RC_PAGE_SIZE : len;
+        norflash_read(updataA.updatabuff, addr, count);
+        crc32_hw_update(updataA.updatabuff, count);
+        addr += count;
+        len -= count;
+    }
+    return crc32_hw_value();
+}
+
+/**
+ * @brief  校验 A 区固件
+ * @details 按 EEPROM 中记录的长度计算 A 区 CRC32 并与记录值比较，未记录时跳过校验。
+ * @retval 1 校验通过或未记录
+ * @retval 0 校验失败
+ */
+uint8_t bootloader_check_a(void)
+{
+    uint32_t tick;
+    uint32_t crc;
+
+    if (!bootloader_crc_valid(OTA_CRC_A_BIT) || (OTA_Info.a_len > F103RC_A_PAGE_NUM * F103RC_PAGE_SIZE)) {
+        return 1;
+    }
+
+    tick = HAL_GetTick();
+    crc = crc32_hw_calc((uint8_t *)F103RC_A_SADDR, OTA_Info.a_len);
+    if (crc != OTA_Info.a_crc) {
+        printf("A区校验失败: CRC32 0x%08lX, 应为 0x%08lX\r\n", crc, OTA_Info.a_crc);
+        return 0;
+    }
+    printf("A区校验通过: %ld字节, %ldms\r\n", OTA_Info.a_len, HAL_GetTick() - tick);
+    return 1;
+}
+
+/**
+ * @brief  查找外部 Flash 中的固件
+ * @details 0 号是 APP 写入的下载区，位于外部 Flash 开头，长度记录在 EEPROM 中；
+ *          其余编号在固件目录中查找。
+ *
+ * @param  id   固件编号
+ * @param  addr 返回固件数据地址
+ * @param  len  返回固件长度
+ * @retval 1 找到
+ * @retval 0 没有该编号的固件
+ */
+uint8_t bootloader_image(uint32_t id, uint32_t *addr, uint32_t *len)
+{
+    const ota_image *image;
+
+    if (id == 0) {
+        *addr = 0;
+        *len = OTA_Info.firlen[0];
+        return OTA_Info.firlen[0] <= OTA_CATALOG_BASE;
+    }
+    image = ota_catalog_find(id);
+    if (image == NULL) {
+        return 0;
+    }
+    *addr = image->addr;
+    *len = image->len;
+    return 1;
+}
+
+/**
+ * @brief  外部 Flash 固件记录的 CRC32
+ * @details 目录中的固件总有 CRC 记录；0 号下载区由 APP 写入，可能没有记录。
+ *
+ * @param  id  固件编号
+ * @param  crc 返回 CRC32
+ * @retval 1 已记录
+ * @retval 0 未记录
+ */
+static uint8_t bootloader_image_crc(uint32_t id, uint32_t *crc)
+{
+    const ota_image *image;
+
+    if (id == 0) {
+        *crc = OTA_Info.fircrc[0];
+        return bootloader_crc_valid(0);
     }
-    return crcinit;
-}
\ No newline at end of file
+    image = ota_catalog_find(id);
+    if (image == NULL) {
+        return 0;
+    }
+    *crc = image->crc;
+    return 1;
+}
+
+/**
+ * @brief  校验外部 Flash 中的固件
+ * @details 搬运到 A 区之前调用，校验失败时不擦写 A 区。未记录 CRC 的 0 号下载区
+ *          (由 APP 写入) 跳过校验。
+ *
+ * @param  id 固件编号
+ * @retval 1 校验通过或未记录
+ * @retval 0 校验失败或没有该编号的固件
+ */
+uint8_t bootloader_check_slot(uint32_t id)
+{
+    uint32_t addr;
+    uint32_t len;
+    uint32_t crc;
+    uint32_t expect;
+
+    if (!bootloader_image(id, &addr, &len)) {
+        printf("外部flash第%ld号没有固件\r\n", id);
+        return 0;
+    }
+    if (!bootloader_image_crc(id, &expect)) {
+        return 1;
+    }
+
+    crc = bootloader_crc_nor(addr, len);
+    if (crc != expect) {
+        printf("外部flash第%ld号校验失败: CRC32 0x%08lX, 应为 0x%08lX\r\n", id, crc, expect);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief  校验搬运到 A 区的固件并记录
+ * @details 外部 Flash 固件有 CRC 记录时，A 区内容必须与之一致；通过后把长度与 CRC
+ *          记录为 A 区的值并写入 EEPROM，供下次启动校验。
+ *
+ * @param  id 固件编号
+ * @retval 1 校验通过
+ * @retval 0 校验失败
+ */
+uint8_t bootloader_check_install(uint32_t id)
+{
+    uint32_t addr;
+    uint32_t len;
+    uint32_t crc;
+    uint32_t expect;
+
+    if (!bootloader_image(id, &addr, &len)) {
+        return 0;
+    }
+    crc = crc32_hw_calc((uint8_t *)F103RC_A_SADDR, len);
+    if (bootloader_image_crc(id, &expect) && (crc != expect)) {
+        printf("A区写入校验失败: CRC32 0x%08lX, 应为 0x%08lX\r\n", crc, expect);
+        return 0;
+    }
+    OTA_Info.a_len = len;
+    bootloader_crc_record(OTA_CRC_A_BIT, crc);
+    at24cxx_write_otainfo();
+    return 1;
+}
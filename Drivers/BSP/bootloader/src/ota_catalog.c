@@ -0,0 +1,277 @@
+/**
+ * @file    ota_catalog.c
+ * @brief   外部 Flash 固件目录实现文件
+ * @details 固件不再放在固定的 64KB 块中 (超过 64KB 的固件会覆盖下一块)：
+ *          1. 每个固件是一条自描述记录 (编号、长度、版本号、CRC32、写入序号)，
+ *             按实际长度占用扇区，最大可以是整个 A 区。
+ *          2. 第一次使用目录时扫描一次目录区建立索引，之后按编号直接查找，不再按块号
+ *             计算地址。直接跳转 APP 的启动过程不使用目录，不需要扫描。
+ *          3. 新记录从最新记录之后查找足够大的空闲区域，到末尾后回到目录区开头；
+ *             各编号当前有效的记录不会被覆盖，旧版本与未完成记录的空间擦除后重新使用。
+ */
+
+#include <stddef.h>
+#include "ota_catalog.h"
+#include "crc32.h"
+
+/**
+ * @brief 目录控制块
+ */
+typedef struct
+{
+    ota_image image[OTA_CATALOG_IDS]; // 各编号当前有效的记录 (下标为编号，0 不使用)
+    uint32_t end;                     // 目录区结束地址 (芯片容量)
+    uint32_t tail;                    // 最新记录的结束地址，新记录从这里开始查找空间
+    uint32_t seq;                     // 下一条记录的写入序号
+    uint32_t open;                    // 正在写入的记录地址，0 表示没有
+    uint8_t loaded;                   // 已扫描目录区
+    ota_catalog_head head;            // 正在写入的记录头 (异步编程期间必须保持有效)
+}catalog_cb;
+
+static catalog_cb ota_catalog;
+
+static void ota_catalog_load(void);
+static uint32_t ota_catalog_extent(uint32_t len);
+static uint32_t ota_catalog_alloc(uint32_t size);
+
+/**
+ * @brief  按编号查找固件
+ * @param  id 固件编号
+ * @return const ota_image* 索引项，没有该编号的固件时为 NULL
+ */
+const ota_image *ota_catalog_find(uint32_t id)
+{
+    if (!ota_catalog.loaded) {
+        ota_catalog_load();
+    }
+    if ((id == 0) || (id >= OTA_CATALOG_IDS) || (ota_catalog.image[id].addr == 0)) {
+        return NULL;
+    }
+    return &ota_catalog.image[id];
+}
+
+/**
+ * @brief  开始写入一条新记录
+ * @details 按最大长度分配空间，排队异步擦除整个区域，再排队写入记录头的前半部分
+ *          (队列按顺序执行，记录头在擦除之后写入)。同一编号原有的记录在新记录完成前
+ *          保持有效，可以作为差分补丁的基准固件。
+ *
+ * @param  id     固件编号 (1 ~ OTA_CATALOG_IDS-1)
+ * @param  maxlen 固件最大长度
+ * @param  erased 擦除完成回调
+ * @return uint32_t 固件数据地址，0 表示编号错误或空间不足
+ */
+uint32_t ota_catalog_begin(uint32_t id, uint32_t maxlen, norflash_cb erased)
+{
+    uint32_t size = ota_catalog_extent(maxlen);
+    uint32_t addr;
+
+    if (!ota_catalog.loaded) {
+        ota_catalog_load();
+    }
+    if ((id == 0) || (id >= OTA_CATALOG_IDS)) {
+        return 0;
+    }
+    addr = ota_catalog_alloc(size);
+    if (addr == 0) {
+        return 0;
+    }
+
+    // 之前中止的下载可能还有擦写在队列中，等待完成后再排队，旧的完成回调不会再到来
+    while (norflash_async_busy()) {
+        norflash_async_poll();
+    }
+
+    memset(&ota_catalog.head, 0xFF, sizeof(ota_catalog.head));
+    ota_catalog.head.magic = OTA_CATALOG_MAGIC;
+    ota_catalog.head.id = id;
+    ota_catalog.head.seq = ota_catalog.seq++;
+    memcpy(ota_catalog.head.ver, OTA_Info.ota_ver, sizeof(ota_catalog.head.ver));
+    ota_catalog.head.hcrc = crc32_hw_calc((uint8_t *)&ota_catalog.head, offsetof(ota_catalog_head, hcrc));
+
+    // 队列满时推进队列直到有空位，擦除与记录头都必须排队成功
+    while (norflash_async_erase(addr, size, erased)) {
+        norflash_async_poll();
+    }
+    while (norflash_async_program((uint8_t *)&ota_catalog.head, addr, sizeof(ota_catalog.head), NULL)) {
+        norflash_async_poll();
+    }
+    ota_catalog.open = addr;
+    return addr + OTA_CATALOG_HEAD;
+}
+
+/**
+ * @brief  完成正在写入的记录
+ * @details 在记录头中写入长度、CRC 与 fcrc (这些位置开始时保持 0xFF，可以直接编程)，
+ *          更新索引，该编号之前的记录成为旧版本。
+ *
+ * @param  len 固件长度
+ * @param  crc 固件 CRC32
+ * @return None
+ */
+void ota_catalog_end(uint32_t len, uint32_t crc)
+{
+    ota_image *image;
+
+    if (ota_catalog.open == 0) {
+        return;
+    }
+
+    ota_catalog.head.len = len;
+    ota_catalog.head.crc = crc;
+    ota_catalog.head.fcrc = crc32_hw_calc((uint8_t *)&ota_catalog.head.len, 8);
+    norflash_write_nocheck((uint8_t *)&ota_catalog.head.len, ota_catalog.open + offsetof(ota_catalog_head, len), 12);
+
+    image = &ota_catalog.image[ota_catalog.head.id];
+    image->addr = ota_catalog.open + OTA_CATALOG_HEAD;
+    image->len = len;
+    image->crc = crc;
+    image->seq = ota_catalog.head.seq;
+    ota_catalog.tail = ota_catalog.open + ota_catalog_extent(len);
+    ota_catalog.open = 0;
+}
+
+/**
+ * @brief  放弃正在写入的记录
+ * @details 记录头没有 fcrc，下次启动扫描时不会使用，所占空间可以再分配。
+ * @return None
+ */
+void ota_catalog_cancel(void)
+{
+    ota_catalog.open = 0;
+}
+
+/**
+ * @brief  打印目录中的固件
+ * @return None
+ */
+void ota_catalog_info(void)
+{
+    ota_catalog_head head;
+    uint32_t id;
+
+    if (!ota_catalog.loaded) {
+        ota_catalog_load();
+    }
+    for (id = 1; id < OTA_CATALOG_IDS; id++) {
+        if (ota_catalog.image[id].addr == 0) {
+            continue;
+        }
+        norflash_read((uint8_t *)&head, ota_catalog.image[id].addr - OTA_CATALOG_HEAD, sizeof(head));
+        printf("外部flash第%ld号: 地址0x%06lX, %ld字节, CRC32 0x%08lX, 序号%ld, %.32s\r\n", id,
+            ota_catalog.image[id].addr, ota_catalog.image[id].len, ota_catalog.image[id].crc,
+            ota_catalog.image[id].seq, head.ver);
+    }
+}
+
+/**
+ * @brief  扫描目录区，建立索引
+ * @details 由各接口在第一次使用目录时调用。逐个扇区读取记录头，magic 与 hcrc 正确的是记录起始扇区 (固件数据中
+ *          出现合法记录头的概率可以忽略)。每个编号保留序号最大的完整记录，
+ *          最新的完整记录结束处作为之后分配空间的起点。
+ * @return None
+ */
+static void ota_catalog_load(void)
+{
+    ota_catalog_head head;
+    ota_image *image;
+    uint32_t addr;
+    uint32_t newest = 0;
+    uint32_t count = 0;
+    uint32_t tick = HAL_GetTick();
+
+    memset(&ota_catalog, 0, sizeof(ota_catalog));
+    ota_catalog.end = norflash_capacity();
+    if (ota_catalog.end < OTA_CATALOG_BASE) {
+        ota_catalog.end = OTA_CATALOG_BASE; // 未知芯片：目录区为空，不能分配
+    }
+    ota_catalog.tail = OTA_CATALOG_BASE;
+    ota_catalog.seq = 1;
+    ota_catalog.loaded = 1;
+
+    for (addr = OTA_CATALOG_BASE; addr < ota_catalog.end; addr += OTA_CATALOG_SECTOR) {
+        norflash_read((uint8_t *)&head, addr, sizeof(head));
+        if ((head.magic != OTA_CATALOG_MAGIC) ||
+            (head.hcrc != crc32_hw_calc((uint8_t *)&head, offsetof(ota_catalog_head, hcrc)))) {
+            continue;
+        }
+        if (head.seq >= ota_catalog.seq) {
+            ota_catalog.seq = head.seq + 1;
+        }
+
+        // 未完成的记录、编号或长度不合法的记录不使用
+        if ((head.fcrc != crc32_hw_calc((uint8_t *)&head.len, 8)) || (head.id == 0) ||
+            (head.id >= OTA_CATALOG_IDS) || (head.len > ota_catalog.end - addr - OTA_CATALOG_HEAD)) {
+            continue;
+        }
+        image = &ota_catalog.image[head.id];
+        if (image->addr && (image->seq > head.seq)) {
+            continue;
+        }
+        if (image->addr == 0) {
+            count++;
+        }
+        image->addr = addr + OTA_CATALOG_HEAD;
+        image->len = head.len;
+        image->crc = head.crc;
+        image->seq = head.seq;
+        if (head.seq > newest) {
+            newest = head.seq;
+            ota_catalog.tail = addr + ota_catalog_extent(head.len);
+        }
+    }
+
+    printf("外部flash固件目录: %ld个固件, 扫描%ldms\r\n", count, HAL_GetTick() - tick);
+}
+
+/**
+ * @brief  记录占用的字节数
+ * @param  len 固件长度
+ * @return uint32_t 记录头 + 按扇区取整的固件数据
+ */
+static uint32_t ota_catalog_extent(uint32_t len)
+{
+    return OTA_CATALOG_HEAD + (len + OTA_CATALOG_SECTOR - 1) / OTA_CATALOG_SECTOR * OTA_CATALOG_SECTOR;
+}
+
+/**
+ * @brief  分配一段空闲区域
+ * @details 从最新记录的结束处开始，跳过与当前有效记录重叠的位置 (首次适配)，
+ *          到目录区末尾后从开头再找一遍。
+ *
+ * @param  size 字节数 (扇区的整数倍)
+ * @return uint32_t 区域起始地址，0 表示空间不足
+ */
+static uint32_t ota_catalog_alloc(uint32_t size)
+{
+    uint32_t pos = ota_catalog.tail;
+    uint32_t start;
+    uint32_t end = 0;
+    uint8_t wrapped = 0;
+    uint8_t id;
+
+    while (1) {
+        if (pos + size > ota_catalog.end) {
+            if (wrapped) {
+                return 0;
+            }
+            wrapped = 1;
+            pos = OTA_CATALOG_BASE;
+        }
+
+        for (id = 1; id < OTA_CATALOG_IDS; id++) {
+            if (ota_catalog.image[id].addr == 0) {
+                continue;
+            }
+            start = ota_catalog.image[id].addr - OTA_CATALOG_HEAD;
+            end = start + ota_catalog_extent(ota_catalog.image[id].len);
+            if ((pos < end) && (start < pos + size)) {
+                break;
+            }
+        }
+        if (id == OTA_CATALOG_IDS) {
+            return pos;
+        }
+        pos = end;
+    }
+}
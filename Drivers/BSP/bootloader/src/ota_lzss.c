@@ -0,0 +1,275 @@
+/**
+ * @file    ota_lzss.c
+ * @brief   压缩固件流式解压实现文件
+ * @details 解压器按位流状态机逐字节处理，压缩数据可以在任意位置被 Xmodem 包或
+ *          流式传输帧切开。解压输出写入 2KB 环形窗口 (从共享缓冲区借用，下载结束时
+ *          由 bootloader 归还)，窗口同时作为输出缓冲：
+ *          每次输入处理完或窗口回绕时，把新产生的数据交给 bootloader_unpacked
+ *          (差分补丁或直接拼页写入)。
+ *          解压出原始长度后忽略剩余输入 (Xmodem 末包填充)。
+ */
+
+#include "ota_lzss.h"
+#include "bootloader.h"
+#include "scratch.h"
+
+#define LZSS_WINDOW_SIZE (1 << LZSS_WINDOW_BITS_MAX)
+#define LZSS_WINDOW_MASK (LZSS_WINDOW_SIZE - 1)
+
+/**
+ * @brief 解压器状态
+ */
+enum
+{
+    LZSS_ST_HEAD,  // 接收压缩头
+    LZSS_ST_TAG,   // 读取标志位
+    LZSS_ST_LIT,   // 读取字面量
+    LZSS_ST_INDEX, // 读取回溯距离
+    LZSS_ST_COUNT, // 读取回溯长度
+    LZSS_ST_DONE,  // 解压完成
+    LZSS_ST_ERROR, // 出错
+};
+
+/**
+ * @brief 解压控制块
+ */
+typedef struct
+{
+    uint8_t *window;                  // 环形窗口 (LZSS_WINDOW_SIZE)，第 n 个输出字节存放在 n % LZSS_WINDOW_SIZE
+    uint8_t head[LZSS_HEAD_LEN];      // 压缩头
+    uint8_t headlen;                  // 已接收压缩头字节数
+    uint8_t state;                    // 解压器状态
+    uint8_t err;                      // 错误码
+    uint8_t wbits;                    // 窗口位数
+    uint8_t lbits;                    // 长度位数
+    uint8_t bitcnt;                   // 位缓冲中的有效位数
+    uint32_t bitbuf;                  // 位缓冲
+    uint16_t index;                   // 回溯距离
+    uint32_t rawlen;                  // 原始长度
+    uint32_t maxlen;                  // 目标区域大小
+    uint32_t outpos;                  // 已解压字节数
+    uint32_t flushed;                 // 已提交给 bootloader_store 的字节数
+}lzss_cb;
+
+static lzss_cb ota_lzss;
+
+static uint8_t ota_lzss_head(void);
+static uint8_t ota_lzss_step(void);
+static uint8_t ota_lzss_next(void);
+static void ota_lzss_copy(uint16_t count);
+static void ota_lzss_flush(void);
+
+/**
+ * @brief  判断数据是否以压缩头开头
+ * @param  data 传输的第一段数据
+ * @param  len  数据长度
+ * @retval 1 压缩固件
+ * @retval 0 未压缩固件
+ */
+uint8_t ota_lzss_detect(uint8_t *data, uint16_t len)
+{
+    return (len >= 3) && (data[0] == 'H') && (data[1] == 'S') && (data[2] == 'Z');
+}
+
+/**
+ * @brief  解压器初始化
+ * @param  maxlen 目标区域大小 (字节)，原始长度超出时拒绝
+ * @return None
+ */
+void ota_lzss_init(uint32_t maxlen)
+{
+    ota_lzss.window = scratch_borrow(SCRATCH_LZSS, LZSS_WINDOW_SIZE);
+    ota_lzss.state = (ota_lzss.window != NULL) ? LZSS_ST_HEAD : LZSS_ST_ERROR;
+    ota_lzss.headlen = 0;
+    ota_lzss.err = (ota_lzss.window != NULL) ? OTA_OK : OTA_ERR_DATA;
+    ota_lzss.bitcnt = 0;
+    ota_lzss.bitbuf = 0;
+    ota_lzss.maxlen = maxlen;
+    ota_lzss.outpos = 0;
+    ota_lzss.flushed = 0;
+}
+
+/**
+ * @brief  压缩数据输入
+ * @param  data 压缩数据 (可以从任意位置切开)
+ * @param  len  数据长度
+ * @return uint8_t 错误码，OTA_OK 表示正常
+ */
+uint8_t ota_lzss_input(uint8_t *data, uint16_t len)
+{
+    while (len && (ota_lzss.state != LZSS_ST_DONE) && (ota_lzss.state != LZSS_ST_ERROR)) {
+        if (ota_lzss.state == LZSS_ST_HEAD) {
+            ota_lzss.head[ota_lzss.headlen++] = *data++;
+            len--;
+            if (ota_lzss.headlen == LZSS_HEAD_LEN) {
+                ota_lzss.err = ota_lzss_head();
+                ota_lzss.state = (ota_lzss.err != OTA_OK) ? LZSS_ST_ERROR :
+                                 (ota_lzss.rawlen == 0) ? LZSS_ST_DONE : LZSS_ST_TAG;
+            }
+            continue;
+        }
+
+        // 每次补充8位，字段最长 LZSS_WINDOW_BITS_MAX 位，位缓冲不会溢出
+        ota_lzss.bitbuf = (ota_lzss.bitbuf << 8) | *data++;
+        ota_lzss.bitcnt += 8;
+        len--;
+        while (ota_lzss_step());
+    }
+
+    ota_lzss_flush();
+    if (ota_lzss.err != OTA_OK) {
+        ota_lzss.state = LZSS_ST_ERROR;
+    }
+    return ota_lzss.err;
+}
+
+/**
+ * @brief  是否已解压出完整的原始数据
+ * @retval 1 完成
+ * @retval 0 未完成
+ */
+uint8_t ota_lzss_done(void)
+{
+    return ota_lzss.state == LZSS_ST_DONE;
+}
+
+/**
+ * @brief  解析压缩头
+ * @return uint8_t 错误码
+ */
+static uint8_t ota_lzss_head(void)
+{
+    ota_lzss.wbits = ota_lzss.head[3] >> 4;
+    ota_lzss.lbits = ota_lzss.head[3] & 0x0F;
+    ota_lzss.rawlen = ota_lzss.head[4] | (ota_lzss.head[5] << 8) | (ota_lzss.head[6] << 16) | ((uint32_t)ota_lzss.head[7] << 24);
+
+    if ((ota_lzss.wbits < 4) || (ota_lzss.wbits > LZSS_WINDOW_BITS_MAX) ||
+        (ota_lzss.lbits < 3) || (ota_lzss.lbits >= ota_lzss.wbits)) {
+        return OTA_ERR_HEAD;
+    }
+    if (ota_lzss.rawlen > ota_lzss.maxlen) {
+        return OTA_ERR_SIZE;
+    }
+    return OTA_OK;
+}
+
+/**
+ * @brief  从位缓冲读取一个字段
+ * @param  bits  字段位数
+ * @param  value 字段值
+ * @retval 1 读取成功
+ * @retval 0 位数不足，等待更多输入
+ */
+static uint8_t ota_lzss_bits(uint8_t bits, uint16_t *value)
+{
+    if (ota_lzss.bitcnt < bits) {
+        return 0;
+    }
+    ota_lzss.bitcnt -= bits;
+    *value = (ota_lzss.bitbuf >> ota_lzss.bitcnt) & ((1UL << bits) - 1);
+    return 1;
+}
+
+/**
+ * @brief  执行一步解压
+ * @retval 1 处理了一个字段，可以继续
+ * @retval 0 位数不足或已结束
+ */
+static uint8_t ota_lzss_step(void)
+{
+    uint16_t value;
+
+    switch (ota_lzss.state) {
+        case LZSS_ST_TAG : {
+            if (!ota_lzss_bits(1, &value)) {
+                return 0;
+            }
+            ota_lzss.state = value ? LZSS_ST_LIT : LZSS_ST_INDEX;
+            break;
+        }
+        case LZSS_ST_LIT : {
+            if (!ota_lzss_bits(8, &value)) {
+                return 0;
+            }
+            ota_lzss.window[ota_lzss.outpos & LZSS_WINDOW_MASK] = value;
+            ota_lzss.outpos++;
+            if ((ota_lzss.outpos & LZSS_WINDOW_MASK) == 0) {
+                ota_lzss_flush();
+            }
+            ota_lzss.state = ota_lzss_next();
+            break;
+        }
+        case LZSS_ST_INDEX : {
+            if (!ota_lzss_bits(ota_lzss.wbits, &value)) {
+                return 0;
+            }
+            ota_lzss.index = value + 1;
+            ota_lzss.state = LZSS_ST_COUNT;
+            break;
+        }
+        case LZSS_ST_COUNT : {
+            if (!ota_lzss_bits(ota_lzss.lbits, &value)) {
+                return 0;
+            }
+            if (ota_lzss.index > ota_lzss.outpos) {
+                ota_lzss.err = OTA_ERR_DATA;
+                ota_lzss.state = LZSS_ST_ERROR;
+                return 0;
+            }
+            ota_lzss_copy(value + 1);
+            ota_lzss.state = ota_lzss_next();
+            break;
+        }
+        default : return 0;
+    }
+    return (ota_lzss.state != LZSS_ST_DONE) && (ota_lzss.state != LZSS_ST_ERROR);
+}
+
+/**
+ * @brief  输出一个字段后的下一状态
+ * @return uint8_t 下游出错时为 LZSS_ST_ERROR，输出满原始长度时为 LZSS_ST_DONE
+ */
+static uint8_t ota_lzss_next(void)
+{
+    if (ota_lzss.err != OTA_OK) {
+        return LZSS_ST_ERROR;
+    }
+    return (ota_lzss.outpos == ota_lzss.rawlen) ? LZSS_ST_DONE : LZSS_ST_TAG;
+}
+
+/**
+ * @brief  回溯复制
+ * @details 按字节复制，距离小于长度时 (重复序列) 读取的是本次刚写入的数据。
+ * @param  count 复制长度
+ * @return None
+ */
+static void ota_lzss_copy(uint16_t count)
+{
+    while (count-- && (ota_lzss.outpos < ota_lzss.rawlen) && (ota_lzss.err == OTA_OK)) {
+        ota_lzss.window[ota_lzss.outpos & LZSS_WINDOW_MASK] =
+            ota_lzss.window[(ota_lzss.outpos - ota_lzss.index) & LZSS_WINDOW_MASK];
+        ota_lzss.outpos++;
+        if ((ota_lzss.outpos & LZSS_WINDOW_MASK) == 0) {
+            ota_lzss_flush();
+        }
+    }
+}
+
+/**
+ * @brief  把新解压的数据交给 bootloader_unpacked
+ * @details 窗口回绕时必定先提交，待提交数据在窗口中总是连续的。下游出错时
+ *          解压器进入出错状态，不再处理后续输入。
+ * @return None
+ */
+static void ota_lzss_flush(void)
+{
+    uint8_t err;
+
+    if (ota_lzss.outpos > ota_lzss.flushed) {
+        err = bootloader_unpacked(&ota_lzss.window[ota_lzss.flushed & LZSS_WINDOW_MASK], ota_lzss.outpos - ota_lzss.flushed);
+        ota_lzss.flushed = ota_lzss.outpos;
+        if ((err != OTA_OK) && (ota_lzss.err == OTA_OK)) {
+            ota_lzss.err = err;
+        }
+    }
+}
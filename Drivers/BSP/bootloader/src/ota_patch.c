@@ -0,0 +1,304 @@
+/**
+ * @file    ota_patch.c
+ * @brief   差分升级补丁流式应用实现文件
+ * @details 补丁数据边接收边应用，不需要缓存整个补丁：
+ *          1. 收到补丁头后，由 bootloader_find_base 按旧固件长度与 CRC32 在 A 区
+ *             和外部 Flash 各固件中查找基准固件，找不到则拒绝补丁。
+ *          2. 差分数据与从基准固件读出的字节相加，新增数据直接输出，结果经
+ *             输出缓冲交给 bootloader_store 按整页写入下载目标。
+ *          基准固件与下载目标不能是同一区域 (边读边写会破坏尚未读取的旧数据)。
+ */
+
+#include "ota_patch.h"
+#include "bootloader.h"
+#include "norflash.h"
+#include "scratch.h"
+
+/**
+ * @brief 补丁应用状态
+ */
+enum
+{
+    PATCH_ST_HEAD,  // 接收补丁头
+    PATCH_ST_CTRL,  // 接收记录头
+    PATCH_ST_DIFF,  // 差分数据
+    PATCH_ST_EXTRA, // 新增数据
+    PATCH_ST_DONE,  // 完成
+    PATCH_ST_ERROR, // 出错
+};
+
+/**
+ * @brief 补丁应用控制块
+ */
+typedef struct
+{
+    uint8_t head[PATCH_HEAD_LEN];   // 补丁头 / 记录头拼接缓冲
+    uint8_t headlen;                // 已拼接字节数
+    uint8_t state;                  // 状态
+    uint8_t err;                    // 错误码
+    uint32_t base;                  // 基准固件位置 (PATCH_BASE_A 或外部 Flash 地址)
+    uint32_t maxlen;                // 目标区域大小
+    uint32_t oldlen;                // 旧固件长度
+    uint32_t newlen;                // 新固件长度
+    uint32_t newcrc;                // 新固件 CRC32
+    uint32_t newpos;                // 已输出的新固件字节数
+    int32_t oldpos;                 // 旧固件读取位置
+    uint32_t difflen;               // 本条记录剩余差分数据
+    uint32_t extralen;              // 本条记录剩余新增数据
+    int32_t seek;                   // 本条记录的偏移调整
+    uint8_t *oldbuf;                // 旧固件读缓冲 (PATCH_OLD_BUF)
+    int32_t oldaddr;                // 读缓冲对应的旧固件位置
+    uint16_t oldcnt;                // 读缓冲有效字节数
+    uint8_t *outbuf;                // 输出缓冲 (PATCH_OUT_BUF)
+    uint16_t outlen;                // 输出缓冲有效字节数
+}patch_cb;
+
+static patch_cb ota_patch;
+
+static uint32_t ota_patch_u32(uint8_t *p);
+static uint8_t ota_patch_head(void);
+static uint8_t ota_patch_ctrl(void);
+static void ota_patch_record_end(void);
+static uint8_t ota_patch_old(uint8_t *value);
+static void ota_patch_flush(void);
+
+/**
+ * @brief  判断数据是否以补丁头开头
+ * @param  data 传输的第一段数据 (解压后)
+ * @param  len  数据长度
+ * @retval 1 差分补丁
+ * @retval 0 完整固件
+ */
+uint8_t ota_patch_detect(uint8_t *data, uint16_t len)
+{
+    return (len >= 4) && (data[0] == 'D') && (data[1] == 'P') && (data[2] == 'T') && (data[3] == '1');
+}
+
+/**
+ * @brief  补丁应用初始化
+ * @param  maxlen 目标区域大小 (字节)，新固件长度超出时拒绝
+ * @return None
+ */
+void ota_patch_init(uint32_t maxlen)
+{
+    // 两个缓冲区从共享缓冲区一次借出，下载结束时由 bootloader 归还
+    ota_patch.oldbuf = scratch_borrow(SCRATCH_PATCH, PATCH_OLD_BUF + PATCH_OUT_BUF);
+    ota_patch.outbuf = ota_patch.oldbuf + PATCH_OLD_BUF;
+    ota_patch.state = (ota_patch.oldbuf != NULL) ? PATCH_ST_HEAD : PATCH_ST_ERROR;
+    ota_patch.headlen = 0;
+    ota_patch.err = (ota_patch.oldbuf != NULL) ? OTA_OK : OTA_ERR_DATA;
+    ota_patch.maxlen = maxlen;
+    ota_patch.newpos = 0;
+    ota_patch.oldpos = 0;
+    ota_patch.oldcnt = 0;
+    ota_patch.outlen = 0;
+}
+
+/**
+ * @brief  补丁数据输入
+ * @param  data 补丁数据 (可以从任意位置切开)
+ * @param  len  数据长度
+ * @return uint8_t 错误码，OTA_OK 表示正常
+ */
+uint8_t ota_patch_input(uint8_t *data, uint16_t len)
+{
+    uint8_t old;
+
+    while (len && (ota_patch.state != PATCH_ST_DONE) && (ota_patch.state != PATCH_ST_ERROR)) {
+        switch (ota_patch.state) {
+            case PATCH_ST_HEAD : {
+                ota_patch.head[ota_patch.headlen++] = *data++;
+                len--;
+                if (ota_patch.headlen == PATCH_HEAD_LEN) {
+                    ota_patch.err = ota_patch_head();
+                    ota_patch.headlen = 0;
+                    ota_patch.state = (ota_patch.err != OTA_OK) ? PATCH_ST_ERROR :
+                                      (ota_patch.newlen == 0) ? PATCH_ST_DONE : PATCH_ST_CTRL;
+                }
+                break;
+            }
+            case PATCH_ST_CTRL : {
+                ota_patch.head[ota_patch.headlen++] = *data++;
+                len--;
+                if (ota_patch.headlen == PATCH_CTRL_LEN) {
+                    ota_patch.err = ota_patch_ctrl();
+                    ota_patch.headlen = 0;
+                    if (ota_patch.err != OTA_OK) {
+                        ota_patch.state = PATCH_ST_ERROR;
+                    }
+                    else if (ota_patch.difflen) {
+                        ota_patch.state = PATCH_ST_DIFF;
+                    }
+                    else if (ota_patch.extralen) {
+                        ota_patch.state = PATCH_ST_EXTRA;
+                    }
+                    else {
+                        ota_patch_record_end();
+                    }
+                }
+                break;
+            }
+            case PATCH_ST_DIFF : {
+                if (!ota_patch_old(&old)) {
+                    ota_patch.err = OTA_ERR_DATA;
+                    ota_patch.state = PATCH_ST_ERROR;
+                    break;
+                }
+                ota_patch.outbuf[ota_patch.outlen++] = *data++ + old;
+                len--;
+                ota_patch.oldpos++;
+                ota_patch.newpos++;
+                if (ota_patch.outlen == PATCH_OUT_BUF) {
+                    ota_patch_flush();
+                }
+                if (--ota_patch.difflen == 0) {
+                    if (ota_patch.extralen) {
+                        ota_patch.state = PATCH_ST_EXTRA;
+                    }
+                    else {
+                        ota_patch_record_end();
+                    }
+                }
+                break;
+            }
+            case PATCH_ST_EXTRA : {
+                ota_patch.outbuf[ota_patch.outlen++] = *data++;
+                len--;
+                ota_patch.newpos++;
+                if (ota_patch.outlen == PATCH_OUT_BUF) {
+                    ota_patch_flush();
+                }
+                if (--ota_patch.extralen == 0) {
+                    ota_patch_record_end();
+                }
+                break;
+            }
+            default : break;
+        }
+    }
+
+    ota_patch_flush();
+    return ota_patch.err;
+}
+
+/**
+ * @brief  是否已输出完整的新固件
+ * @retval 1 完成
+ * @retval 0 未完成
+ */
+uint8_t ota_patch_done(void)
+{
+    return ota_patch.state == PATCH_ST_DONE;
+}
+
+/**
+ * @brief  补丁头中记录的新固件 CRC32
+ * @return uint32_t CRC32
+ */
+uint32_t ota_patch_crc(void)
+{
+    return ota_patch.newcrc;
+}
+
+/**
+ * @brief  读取小端 uint32
+ * @param  p 数据
+ * @return uint32_t 数值
+ */
+static uint32_t ota_patch_u32(uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * @brief  解析补丁头并查找基准固件
+ * @return uint8_t 错误码
+ */
+static uint8_t ota_patch_head(void)
+{
+    uint32_t oldcrc;
+
+    ota_patch.oldlen = ota_patch_u32(&ota_patch.head[4]);
+    oldcrc = ota_patch_u32(&ota_patch.head[8]);
+    ota_patch.newlen = ota_patch_u32(&ota_patch.head[12]);
+    ota_patch.newcrc = ota_patch_u32(&ota_patch.head[16]);
+
+    if (ota_patch.newlen > ota_patch.maxlen) {
+        return OTA_ERR_SIZE;
+    }
+    if (!bootloader_find_base(ota_patch.oldlen, oldcrc, &ota_patch.base)) {
+        return OTA_ERR_BASE;
+    }
+    return OTA_OK;
+}
+
+/**
+ * @brief  解析记录头
+ * @return uint8_t 错误码
+ */
+static uint8_t ota_patch_ctrl(void)
+{
+    ota_patch.difflen = ota_patch_u32(&ota_patch.head[0]);
+    ota_patch.extralen = ota_patch_u32(&ota_patch.head[4]);
+    ota_patch.seek = (int32_t)ota_patch_u32(&ota_patch.head[8]);
+
+    // 记录输出不能超过新固件长度
+    if ((ota_patch.difflen > ota_patch.newlen - ota_patch.newpos) ||
+        (ota_patch.extralen > ota_patch.newlen - ota_patch.newpos - ota_patch.difflen)) {
+        return OTA_ERR_DATA;
+    }
+    return OTA_OK;
+}
+
+/**
+ * @brief  一条记录结束：调整旧固件读取位置，判断是否完成
+ * @return None
+ */
+static void ota_patch_record_end(void)
+{
+    ota_patch.oldpos += ota_patch.seek;
+    ota_patch.state = (ota_patch.newpos == ota_patch.newlen) ? PATCH_ST_DONE : PATCH_ST_CTRL;
+}
+
+/**
+ * @brief  读取当前位置的旧固件字节
+ * @details A 区直接按地址读取；外部 Flash 每次读入 PATCH_OLD_BUF 字节缓存，
+ *          差分数据大多顺序读取旧固件，缓存命中率高。
+ *
+ * @param  value 读出的字节
+ * @retval 1 成功
+ * @retval 0 读取位置超出旧固件
+ */
+static uint8_t ota_patch_old(uint8_t *value)
+{
+    int32_t pos = ota_patch.oldpos;
+
+    if ((pos < 0) || ((uint32_t)pos >= ota_patch.oldlen)) {
+        return 0;
+    }
+
+    if (ota_patch.base == PATCH_BASE_A) {
+        *value = *(__IO uint8_t *)(F103RC_A_SADDR + pos);
+        return 1;
+    }
+
+    if ((pos < ota_patch.oldaddr) || (pos >= ota_patch.oldaddr + ota_patch.oldcnt)) {
+        ota_patch.oldaddr = pos;
+        ota_patch.oldcnt = (ota_patch.oldlen - pos > PATCH_OLD_BUF) ? PATCH_OLD_BUF : (ota_patch.oldlen - pos);
+        norflash_read(ota_patch.oldbuf, ota_patch.base + pos, ota_patch.oldcnt);
+    }
+    *value = ota_patch.oldbuf[pos - ota_patch.oldaddr];
+    return 1;
+}
+
+/**
+ * @brief  把输出缓冲交给 bootloader_store
+ * @return None
+ */
+static void ota_patch_flush(void)
+{
+    if (ota_patch.outlen) {
+        bootloader_store(ota_patch.outbuf, ota_patch.outlen);
+        ota_patch.outlen = 0;
+    }
+}
@@ -0,0 +1,417 @@
+/**
+ * @file    ota_stream.c
+ * @brief   滑动窗口流式传输协议实现文件
+ * @details Xmodem 每包都要等待 ACK，吞吐量受限于 包长/往返时延。本协议允许主机
+ *          连续发出 STREAM_WINDOW 个带序号的数据帧：
+ *          1. 按序到达的帧直接从串口接收缓冲区交给 bootloader_store 逐页写入 Flash，
+ *             只有乱序到达的帧复制到重排缓冲区，等前面的帧到达后再按序提交。
+ *          2. 每收到一帧回复累计应答 (下一个期望序号) + 选择应答位图。
+ *          3. 主机只重传位图中缺失或超时未确认的帧。
+ *          串口数据按字节流解析，一次接收可以包含多个帧或半个帧；分在几次接收中的帧
+ *          在循环接收缓冲区中本来就是相邻的，不再复制到单独的拼接缓冲区。
+ *          传输开始前主机可以协商更高的波特率，切换后由测试帧确认，超时双方各自
+ *          恢复原波特率。
+ */
+
+#include "ota_stream.h"
+#include "bootloader.h"
+#include "ota_uart.h"
+#include "scratch.h"
+
+#define STREAM_SLOT_NONE 0xFF // 序号没有对应的槽位 (未收到)
+
+/**
+ * @brief 流式传输控制块
+ */
+typedef struct
+{
+    uint8_t *framestart;                          // 正在接收的帧在接收缓冲区中的起始位置
+    uint16_t framelen;                            // 已收到的字节数
+    uint16_t framesize;                           // 帧总长度 (收齐帧头后有效)
+    uint8_t *slot;                                // 重排缓冲区，STREAM_SLOTS 个槽位，从共享缓冲区借用，NULL 时不缓存乱序帧
+    uint16_t slotlen[STREAM_SLOTS];               // 各槽位有效负载长度
+    uint8_t slotmap[STREAM_WINDOW];               // 序号 n 所在的槽位 (下标 n % STREAM_WINDOW)
+    uint8_t slotused;                             // 已占用的槽位 (位图)
+    uint16_t base;                                // 下一个按序提交的帧序号
+    uint16_t total;                               // 总帧数
+    uint8_t started;                              // 已收到 START 帧
+    uint8_t baud_pending;                         // 已切换波特率，等待测试帧确认
+    uint32_t baud_default;                        // 进入流式传输时的波特率
+    uint32_t baud_old;                            // 切换前的波特率
+    uint32_t baud_tick;                           // 切换波特率的时刻
+    uint32_t rx_tick;                             // 最近一次收到有效帧的时刻
+}stream_cb;
+
+static stream_cb ota_stream;
+
+static void ota_stream_send(uint8_t type, uint16_t seq, uint8_t *payload, uint16_t len);
+static void ota_stream_ack(void);
+static void ota_stream_frame(uint8_t *frame, uint16_t paylen);
+static uint8_t ota_stream_deliver(uint8_t *payload, uint16_t len);
+static void ota_stream_hold(uint16_t seq, uint8_t *payload, uint16_t len);
+static void ota_stream_abort(uint8_t err);
+static void ota_stream_baud(uint32_t baud);
+static void ota_stream_baud_restore(void);
+
+/**
+ * @brief  流式传输状态初始化
+ * @details 从共享缓冲区借用重排缓冲区，下载结束或中止时由 bootloader 归还。
+ * @return None
+ */
+void ota_stream_init(void)
+{
+    ota_stream.slot = scratch_borrow(SCRATCH_STREAM, STREAM_SLOTS * STREAM_DATA_MAX);
+    memset(ota_stream.slotmap, STREAM_SLOT_NONE, sizeof(ota_stream.slotmap));
+    ota_stream.slotused = 0;
+    ota_stream.framelen = 0;
+    ota_stream.base = 0;
+    ota_stream.total = 0;
+    ota_stream.started = 0;
+    ota_stream.baud_pending = 0;
+    ota_stream.baud_default = ota_uart_get_baud();
+    ota_stream.rx_tick = HAL_GetTick();
+}
+
+/**
+ * @brief  流式传输超时处理
+ * @details 在主循环中周期调用：
+ *          1. 切换波特率后 STREAM_BAUD_TIMEOUT 内未收到测试帧，恢复原波特率。
+ *          2. 非默认波特率下 STREAM_IDLE_TIMEOUT 内没有有效帧 (主机已断开)，
+ *             恢复默认波特率，保证命令行可以重新连接。
+ * @return None
+ */
+void ota_stream_poll(void)
+{
+    if (ota_stream.baud_pending && (HAL_GetTick() - ota_stream.baud_tick > STREAM_BAUD_TIMEOUT)) {
+        ota_stream.baud_pending = 0;
+        ota_uart_set_baud(ota_stream.baud_old);
+    }
+    if (HAL_GetTick() - ota_stream.rx_tick > STREAM_IDLE_TIMEOUT) {
+        ota_stream_baud_restore();
+    }
+}
+
+/**
+ * @brief  流式传输数据输入
+ * @details 按字节搜索帧头，只记录帧的起始位置与已收到的字节数，帧可以跨越多次串口接收。
+ *          帧收齐后由 ota_uart_rx_join 得到接收缓冲区中连续的帧，原地处理。
+ *
+ * @param  data 串口接收到的数据 (接收缓冲区中)
+ * @param  len  数据长度
+ * @return None
+ */
+void ota_stream_input(uint8_t *data, uint16_t len)
+{
+    uint8_t *frame;
+    uint16_t paylen;
+    uint16_t n;
+
+    while (len) {
+        // 搜索帧头
+        if (ota_stream.framelen == 0) {
+            if (*data != STREAM_SYNC) {
+                data++;
+                len--;
+                continue;
+            }
+            ota_stream.framestart = data;
+        }
+
+        // 帧头逐字节接收，之后一次跳过帧的剩余部分
+        n = (ota_stream.framelen < STREAM_HEAD_LEN) ? 1 : (ota_stream.framesize - ota_stream.framelen);
+        if (n > len) {
+            n = len;
+        }
+        ota_stream.framelen += n;
+        data += n;
+        len -= n;
+
+        if (ota_stream.framelen == STREAM_HEAD_LEN) {
+            frame = ota_uart_rx_join(ota_stream.framestart, STREAM_HEAD_LEN);
+            paylen = frame[4] | (frame[5] << 8);
+            if (paylen > STREAM_DATA_MAX) {
+                ota_stream.framelen = 0; // 长度非法，重新同步
+                continue;
+            }
+            ota_stream.framesize = STREAM_HEAD_LEN + paylen + 2;
+        }
+        else if ((ota_stream.framelen > STREAM_HEAD_LEN) && (ota_stream.framelen == ota_stream.framesize)) {
+            frame = ota_uart_rx_join(ota_stream.framestart, ota_stream.framesize);
+            ota_stream.framelen = 0;
+            ota_stream_frame(frame, ota_stream.framesize - STREAM_HEAD_LEN - 2);
+            if (!(boot_state_flag & IAP_STREAM_FLAG)) {
+                return; // 传输已结束或中止，重排缓冲区已归还
+            }
+        }
+    }
+}
+
+/**
+ * @brief  处理一个完整的帧
+ * @param  frame  帧数据 (从帧头开始，在接收缓冲区中)
+ * @param  paylen 负载长度
+ * @return None
+ */
+static void ota_stream_frame(uint8_t *frame, uint16_t paylen)
+{
+    uint16_t crc;
+    uint16_t seq;
+    uint16_t idx;
+    uint8_t slot;
+    uint32_t totallen;
+    uint32_t maxlen;
+
+    // CRC 校验失败：回复当前窗口状态，主机据位图重传
+    crc = xmodem_crc16(&frame[1], STREAM_HEAD_LEN - 1 + paylen);
+    if (crc != (frame[STREAM_HEAD_LEN + paylen] * 256 + frame[STREAM_HEAD_LEN + paylen + 1])) {
+        if (ota_stream.started) {
+            ota_stream_ack();
+        }
+        return;
+    }
+
+    seq = frame[2] | (frame[3] << 8);
+    ota_stream.rx_tick = HAL_GetTick();
+
+    switch (frame[1]) {
+        case STREAM_START : {
+            if (paylen != 4) {
+                break;
+            }
+            totallen = frame[6] | (frame[7] << 8) | (frame[8] << 16) | ((uint32_t)frame[9] << 24);
+            // 压缩固件的原始长度由解压器检查
+            maxlen = bootloader_target_size();
+            if (totallen > maxlen) {
+                ota_stream_abort(STREAM_ERR_SIZE);
+                break;
+            }
+            // 主机重发 START (应答丢失) 时不重置已接收的数据
+            if (!ota_stream.started) {
+                ota_stream.started = 1;
+                ota_stream.total = (totallen + STREAM_DATA_MAX - 1) / STREAM_DATA_MAX;
+                updataA.xmodemNB = 0;
+                updataA.xmodemLen = 0;
+            }
+            ota_stream_ack();
+            break;
+        }
+        case STREAM_DATA : {
+            if (!ota_stream.started) {
+                break;
+            }
+            // 期望的帧直接从接收缓冲区提交；窗口内未收到的乱序帧放入重排缓冲区，
+            // 重复帧与窗口外的帧只回复应答
+            if (((uint16_t)(seq - ota_stream.base) < STREAM_WINDOW) && (seq < ota_stream.total)) {
+                if (seq == ota_stream.base) {
+                    if (ota_stream_deliver(&frame[STREAM_HEAD_LEN], paylen)) {
+                        return;
+                    }
+                }
+                else {
+                    ota_stream_hold(seq, &frame[STREAM_HEAD_LEN], paylen);
+                }
+            }
+            // 按序提交重排缓冲区中接续的帧
+            idx = ota_stream.base % STREAM_WINDOW;
+            while (ota_stream.slotmap[idx] != STREAM_SLOT_NONE) {
+                slot = ota_stream.slotmap[idx];
+                ota_stream.slotmap[idx] = STREAM_SLOT_NONE;
+                ota_stream.slotused &= ~(1 << slot);
+                if (ota_stream_deliver(&ota_stream.slot[slot * STREAM_DATA_MAX], ota_stream.slotlen[slot])) {
+                    return;
+                }
+                idx = ota_stream.base % STREAM_WINDOW;
+            }
+            ota_stream_ack();
+            break;
+        }
+        case STREAM_END : {
+            if (!ota_stream.started) {
+                break;
+            }
+            if ((seq == ota_stream.total) && (ota_stream.base == ota_stream.total)) {
+                if (!bootloader_receive_complete()) {
+                    ota_stream_abort(STREAM_ERR_DATA);
+                    break;
+                }
+                ota_stream_send(STREAM_DONE, ota_stream.total, NULL, 0);
+                ota_stream.started = 0;
+                ota_stream_baud_restore();
+                bootloader_download_finish();
+            }
+            else {
+                ota_stream_ack();
+            }
+            break;
+        }
+        case STREAM_BAUD : {
+            // 只在传输开始前协商
+            if ((paylen != 4) || ota_stream.started) {
+                break;
+            }
+            ota_stream_baud(frame[6] | (frame[7] << 8) | (frame[8] << 16) | ((uint32_t)frame[9] << 24));
+            break;
+        }
+        case STREAM_TEST : {
+            if (paylen > 8) {
+                break;
+            }
+            // 以新波特率收到测试帧，协商完成
+            ota_stream.baud_pending = 0;
+            ota_stream_send(STREAM_TEST_ACK, seq, &frame[STREAM_HEAD_LEN], paylen);
+            break;
+        }
+        default : break;
+    }
+}
+
+/**
+ * @brief  按序提交一帧负载
+ * @param  payload 负载
+ * @param  len     负载长度
+ * @retval 0 成功
+ * @retval 1 写入失败，传输已中止
+ */
+static uint8_t ota_stream_deliver(uint8_t *payload, uint16_t len)
+{
+    uint8_t err = bootloader_receive(payload, len);
+
+    if (err != OTA_OK) {
+        ota_stream_abort((err == OTA_ERR_SIZE) ? STREAM_ERR_SIZE :
+                         (err == OTA_ERR_BASE) ? STREAM_ERR_BASE :
+                         (err == OTA_ERR_FLASH) ? STREAM_ERR_FLASH : STREAM_ERR_DATA);
+        return 1;
+    }
+    ota_stream.base++;
+    updataA.xmodemNB++;
+    return 0;
+}
+
+/**
+ * @brief  缓存乱序到达的帧
+ * @details 窗口内除期望帧之外最多 STREAM_SLOTS 个帧，槽位一定够用；没有借到重排缓冲区时
+ *          不缓存，应答位图中不包含该帧，主机会重传。
+ *
+ * @param  seq     帧序号 (窗口内，不是期望帧)
+ * @param  payload 负载
+ * @param  len     负载长度
+ * @return None
+ */
+static void ota_stream_hold(uint16_t seq, uint8_t *payload, uint16_t len)
+{
+    uint8_t slot;
+
+    if ((ota_stream.slot == NULL) || (ota_stream.slotmap[seq % STREAM_WINDOW] != STREAM_SLOT_NONE)) {
+        return;
+    }
+    for (slot = 0; ota_stream.slotused & (1 << slot); slot++);
+    memcpy(&ota_stream.slot[slot * STREAM_DATA_MAX], payload, len);
+    ota_stream.slotlen[slot] = len;
+    ota_stream.slotused |= 1 << slot;
+    ota_stream.slotmap[seq % STREAM_WINDOW] = slot;
+}
+
+/**
+ * @brief  切换波特率
+ * @details 先以当前波特率发送应答 (负载为新波特率，不支持时为0)，发送完成后切换。
+ *          切换到非默认波特率时等待主机的测试帧确认。
+ *
+ * @param  baud 新波特率
+ * @return None
+ */
+static void ota_stream_baud(uint32_t baud)
+{
+    uint8_t payload[4];
+    uint32_t old = ota_uart_get_baud();
+
+    if (baud == old) {
+        return;
+    }
+    if (!ota_uart_baud_check(baud)) {
+        baud = 0;
+    }
+    payload[0] = baud & 0xFF;
+    payload[1] = (baud >> 8) & 0xFF;
+    payload[2] = (baud >> 16) & 0xFF;
+    payload[3] = baud >> 24;
+    ota_stream_send(STREAM_BAUD_ACK, 0, payload, 4);
+    if (baud == 0) {
+        return;
+    }
+
+    ota_uart_set_baud(baud);
+    ota_stream.baud_old = old;
+    ota_stream.baud_tick = HAL_GetTick();
+    ota_stream.baud_pending = (baud != ota_stream.baud_default);
+}
+
+/**
+ * @brief  恢复进入流式传输时的波特率 (不发送应答，等待已发送的数据发完再切换)
+ * @return None
+ */
+static void ota_stream_baud_restore(void)
+{
+    ota_stream.baud_pending = 0;
+    if (ota_uart_get_baud() != ota_stream.baud_default) {
+        ota_uart_set_baud(ota_stream.baud_default);
+    }
+}
+
+/**
+ * @brief  中止传输
+ * @param  err 中止原因
+ * @return None
+ */
+static void ota_stream_abort(uint8_t err)
+{
+    ota_stream_send(STREAM_ABORT, 0, &err, 1);
+    ota_stream.started = 0;
+    ota_stream_baud_restore();
+    bootloader_download_abort();
+}
+
+/**
+ * @brief  发送应答帧
+ * @details 序号为下一个期望帧，位图 bit i 表示序号 base+1+i 的帧已在重排缓冲区中。
+ * @return None
+ */
+static void ota_stream_ack(void)
+{
+    uint8_t bitmap = 0;
+    uint8_t i;
+
+    for (i = 0; i < STREAM_WINDOW - 1; i++) {
+        if (ota_stream.slotmap[(ota_stream.base + 1 + i) % STREAM_WINDOW] != STREAM_SLOT_NONE) {
+            bitmap |= 1 << i;
+        }
+    }
+    ota_stream_send(STREAM_ACK, ota_stream.base, &bitmap, 1);
+}
+
+/**
+ * @brief  组帧并发送
+ * @param  type    帧类型
+ * @param  seq     序号
+ * @param  payload 负载
+ * @param  len     负载长度
+ * @return None
+ */
+static void ota_stream_send(uint8_t type, uint16_t seq, uint8_t *payload, uint16_t len)
+{
+    uint8_t buf[STREAM_HEAD_LEN + 8 + 2]; // 设备发出的帧负载不超过8字节
+    uint16_t crc;
+
+    buf[0] = STREAM_SYNC;
+    buf[1] = type;
+    buf[2] = seq & 0xFF;
+    buf[3] = seq >> 8;
+    buf[4] = len & 0xFF;
+    buf[5] = len >> 8;
+    if (len) {
+        memcpy(&buf[STREAM_HEAD_LEN], payload, len);
+    }
+    crc = xmodem_crc16(&buf[1], STREAM_HEAD_LEN - 1 + len);
+    buf[STREAM_HEAD_LEN + len] = crc >> 8;
+    buf[STREAM_HEAD_LEN + len + 1] = crc & 0xFF;
+    ota_uart_send(buf, STREAM_HEAD_LEN + len + 2);
+}
@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+"""
+压缩固件生成工具 (LZSS, heatshrink 位流格式)
+
+与 Drivers/BSP/bootloader/src/ota_lzss.c 配套。输出文件带 "HSZ" 压缩头，
+可以直接用 Xmodem 发送，或由 ota_stream.py -z 压缩后发送，设备自动识别并解压：
+
+    python3 tools/lzss.py app.bin app.hsz
+    python3 tools/lzss.py -d app.hsz check.bin    # 解压校验
+
+窗口位数不能超过设备的 LZSS_WINDOW_BITS_MAX (11)。仅依赖标准库。
+"""
+
+import argparse
+import struct
+import sys
+
+MAGIC = b"HSZ"
+HEAD_LEN = 8
+MAX_CHAIN = 256  # 每个位置最多比较的候选数
+
+
+class BitWriter:
+    def __init__(self):
+        self.out = bytearray()
+        self.acc = 0
+        self.n = 0
+
+    def put(self, value, bits):
+        self.acc = (self.acc << bits) | value
+        self.n += bits
+        while self.n >= 8:
+            self.n -= 8
+            self.out.append((self.acc >> self.n) & 0xFF)
+        self.acc &= (1 << self.n) - 1
+
+    def finish(self):
+        if self.n:
+            self.out.append((self.acc << (8 - self.n)) & 0xFF)
+        return bytes(self.out)
+
+
+def compress(data, wbits=11, lbits=4):
+    """压缩数据，返回带压缩头的完整文件内容"""
+    if not (4 <= wbits <= 15 and 3 <= lbits < wbits):
+        raise ValueError("参数不支持: W=%d L=%d" % (wbits, lbits))
+    window = 1 << wbits
+    maxlen = 1 << lbits
+    # 回溯编码 1+W+L 位，字面量 9 位，不短于该长度的匹配才划算
+    minlen = (1 + wbits + lbits) // 9 + 1
+
+    bw = BitWriter()
+    head = {}   # 3 字节前缀 -> 最近位置
+    prev = {}   # 位置 -> 同前缀的上一个位置
+    n = len(data)
+
+    def insert(i):
+        if i + 3 <= n:
+            key = data[i:i + 3]
+            p = head.get(key)
+            if p is not None:
+                prev[i] = p
+            head[key] = i
+
+    i = 0
+    while i < n:
+        best_len, best_dist = 0, 0
+        if i + 3 <= n:
+            cand = head.get(data[i:i + 3])
+            chain = 0
+            limit = min(maxlen, n - i)
+            while cand is not None and i - cand <= window and chain < MAX_CHAIN:
+                length = 3
+                while length < limit and data[cand + length] == data[i + length]:
+                    length += 1
+                if length > best_len:
+                    best_len, best_dist = length, i - cand
+                    if length == limit:
+                        break
+                cand = prev.get(cand)
+                chain += 1
+        if best_len >= max(minlen, 3):
+            bw.put(0, 1)
+            bw.put(best_dist - 1, wbits)
+            bw.put(best_len - 1, lbits)
+            for k in range(best_len):
+                insert(i + k)
+            i += best_len
+        else:
+            bw.put(1, 1)
+            bw.put(data[i], 8)
+            insert(i)
+            i += 1
+
+    return MAGIC + bytes([(wbits << 4) | lbits]) + struct.pack("<I", n) + bw.finish()
+
+
+def decompress(blob):
+    """解压带压缩头的数据，算法与设备端一致"""
+    if blob[:3] != MAGIC or len(blob) < HEAD_LEN:
+        raise ValueError("不是压缩文件")
+    wbits, lbits = blob[3] >> 4, blob[3] & 0x0F
+    (rawlen,) = struct.unpack("<I", blob[4:8])
+    out = bytearray()
+    acc, nbits, pos = 0, 0, HEAD_LEN
+
+    def get(bits):
+        nonlocal acc, nbits, pos
+        while nbits < bits:
+            if pos >= len(blob):
+                raise ValueError("压缩数据不完整")
+            acc = (acc << 8) | blob[pos]
+            pos += 1
+            nbits += 8
+        nbits -= bits
+        return (acc >> nbits) & ((1 << bits) - 1)
+
+    while len(out) < rawlen:
+        if get(1):
+            out.append(get(8))
+        else:
+            dist = get(wbits) + 1
+            count = get(lbits) + 1
+            if dist > len(out):
+                raise ValueError("回溯距离超出已解压数据")
+            for _ in range(min(count, rawlen - len(out))):
+                out.append(out[-dist])
+    return bytes(out)
+
+
+def main():
+    ap = argparse.ArgumentParser(description="压缩固件生成工具 (LZSS, heatshrink 格式)")
+    ap.add_argument("input")
+    ap.add_argument("output")
+    ap.add_argument("-d", "--decompress", action="store_true", help="解压")
+    ap.add_argument("-w", "--window", type=int, default=11, help="窗口位数 W (4~11)")
+    ap.add_argument("-l", "--length", type=int, default=4, help="长度位数 L")
+    args = ap.parse_args()
+
+    with open(args.input, "rb") as f:
+        data = f.read()
+
+    if args.decompress:
+        out = decompress(data)
+    else:
+        out = compress(data, args.window, args.length)
+        if decompress(out) != data:
+            print("错误: 解压校验失败", file=sys.stderr)
+            return 1
+        print("%d -> %d 字节 (%.1f%%)" % (len(data), len(out), 100.0 * len(out) / max(len(data), 1)))
+
+    with open(args.output, "wb") as f:
+        f.write(out)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
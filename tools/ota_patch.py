@@ -0,0 +1,171 @@
+#!/usr/bin/env python3
+"""
+差分升级补丁生成工具
+
+与 Drivers/BSP/bootloader/src/ota_patch.c 配套。由设备上已有的旧固件与新固件
+生成 bsdiff 式补丁，默认再用 lzss.py 压缩 (差分数据大多为 0，压缩率很高)：
+
+    python3 tools/ota_patch.py old.bin new.bin update.dpt
+    python3 tools/ota_patch.py --apply old.bin update.dpt check.bin   # 应用补丁校验
+
+补丁与完整固件一样通过 Xmodem 或 ota_stream.py 发送到 [2] (A 区) 或 [5] (外部
+flash)，设备按补丁头中的旧固件长度与 CRC32 在 A 区与外部 flash 中自动查找基准固件，
+基准固件不能与下载目标相同。仅依赖标准库。
+"""
+
+import argparse
+import struct
+import sys
+
+import lzss
+
+MAGIC = b"DPT1"
+HEAD_LEN = 20
+CTRL_LEN = 12
+
+BLOCK = 8        # 查找新对齐位置时的最短精确匹配
+MISMATCH = 16    # 连续不同字节数达到该值时结束当前差分段
+MAX_CAND = 32    # 每个位置最多比较的候选数
+PATCH_LBITS = 8  # 压缩补丁时的长度位数，差分数据中的长串 0 每条回溯可覆盖 256 字节
+
+
+def crc32_stm32(data):
+    """与 STM32 硬件 CRC 单元一致：CRC-32/MPEG-2，按小端32位字输入，末尾以 0xFF 补齐"""
+    if len(data) % 4:
+        data = data + b"\xFF" * (4 - len(data) % 4)
+    crc = 0xFFFFFFFF
+    for (word,) in struct.iter_unpack("<I", data):
+        crc ^= word
+        for _ in range(32):
+            crc = ((crc << 1) ^ 0x04C11DB7) if crc & 0x80000000 else (crc << 1)
+            crc &= 0xFFFFFFFF
+    return crc
+
+
+def _match_len(old, new, op, np_, limit):
+    n = 0
+    while n < limit and op + n < len(old) and np_ + n < len(new) and old[op + n] == new[np_ + n]:
+        n += 1
+    return n
+
+
+def diff(old, new):
+    """生成补丁记录列表 [(差分数据, 新增数据, 偏移调整)]
+
+    与 bsdiff 相同，差分段允许少量字节不同 (例如函数地址整体偏移后的指令)，
+    只在连续 MISMATCH 个字节不同时结束，再查找下一个对齐位置。
+    """
+    index = {}
+    for j in range(len(old) - BLOCK + 1):
+        index.setdefault(old[j:j + BLOCK], []).append(j)
+
+    def find(start, off):
+        """从 start 开始查找下一个能与旧固件精确匹配 BLOCK 字节的位置，
+        优先沿用当前对齐 off，返回 (新位置, 旧位置)，找不到时旧位置为 None"""
+        for i in range(start, len(new) - BLOCK + 1):
+            key = new[i:i + BLOCK]
+            if 0 <= i + off and old[i + off:i + off + BLOCK] == key:
+                return i, i + off
+            cands = index.get(key)
+            if cands:
+                best = max(cands[:MAX_CAND], key=lambda c: _match_len(old, new, c, i, 256))
+                return i, best
+        return len(new), None
+
+    def extend(i, o):
+        """从新固件 i / 旧固件 o 开始的差分段结束位置"""
+        run = 0
+        k = 0
+        while i + k < len(new) and o + k < len(old):
+            if new[i + k] == old[o + k]:
+                run = 0
+            else:
+                run += 1
+                if run >= MISMATCH:
+                    return i + k - run + 1
+            k += 1
+        return i + k - run
+
+    # 第一条记录只有新增数据，并把旧固件读取位置移到第一个对齐位置
+    i, oldpos = find(0, 0)
+    records = [(b"", new[:i], oldpos or 0)]
+    while i < len(new):
+        j = extend(i, oldpos)
+        d = bytes((new[i + k] - old[oldpos + k]) & 0xFF for k in range(j - i))
+        oldend = oldpos + (j - i)
+        i, oldpos = find(j, oldend - j)
+        if oldpos is None:
+            records.append((d, new[j:], 0))
+            break
+        records.append((d, new[j:i], oldpos - oldend))
+    return records
+
+
+def build(old, new, records):
+    out = bytearray(MAGIC)
+    out += struct.pack("<IIII", len(old), crc32_stm32(old), len(new), crc32_stm32(new))
+    for d, e, seek in records:
+        out += struct.pack("<IIi", len(d), len(e), seek)
+        out += d
+        out += e
+    return bytes(out)
+
+
+def apply(old, patch):
+    """应用补丁，算法与设备端一致"""
+    if patch[:4] != MAGIC:
+        raise ValueError("不是补丁文件")
+    oldlen, oldcrc, newlen, newcrc = struct.unpack("<IIII", patch[4:HEAD_LEN])
+    if len(old) != oldlen or crc32_stm32(old) != oldcrc:
+        raise ValueError("基准固件不匹配")
+    new = bytearray()
+    pos, oldpos = HEAD_LEN, 0
+    while len(new) < newlen:
+        dlen, elen, seek = struct.unpack("<IIi", patch[pos:pos + CTRL_LEN])
+        pos += CTRL_LEN
+        for k in range(dlen):
+            new.append((patch[pos + k] + old[oldpos + k]) & 0xFF)
+        pos += dlen
+        oldpos += dlen
+        new += patch[pos:pos + elen]
+        pos += elen
+        oldpos += seek
+    if crc32_stm32(bytes(new)) != newcrc:
+        raise ValueError("新固件 CRC32 校验失败")
+    return bytes(new)
+
+
+def main():
+    ap = argparse.ArgumentParser(description="差分升级补丁生成工具")
+    ap.add_argument("old", help="旧固件 (设备上的基准固件)")
+    ap.add_argument("new", help="新固件；--apply 时为补丁文件")
+    ap.add_argument("output")
+    ap.add_argument("--apply", action="store_true", help="应用补丁 (校验用)")
+    ap.add_argument("--no-compress", action="store_true", help="不压缩补丁")
+    args = ap.parse_args()
+
+    with open(args.old, "rb") as f:
+        old = f.read()
+    with open(args.new, "rb") as f:
+        new = f.read()
+
+    if args.apply:
+        if new[:3] == lzss.MAGIC:
+            new = lzss.decompress(new)
+        out = apply(old, new)
+    else:
+        patch = build(old, new, diff(old, new))
+        if apply(old, patch) != new:
+            print("错误: 补丁校验失败", file=sys.stderr)
+            return 1
+        out = patch if args.no_compress else lzss.compress(patch, 11, PATCH_LBITS)
+        print("新固件 %d 字节, 补丁 %d 字节, 发送 %d 字节 (%.1f%%)"
+              % (len(new), len(patch), len(out), 100.0 * len(out) / max(len(new), 1)))
+
+    with open(args.output, "wb") as f:
+        f.write(out)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
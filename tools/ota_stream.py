@@ -0,0 +1,327 @@
+#!/usr/bin/env python3
+"""
+OTA 滑动窗口流式传输发送端
+
+与 Drivers/BSP/bootloader/src/ota_stream.c 配套。先在 bootloader 命令行选择
+[2] (A 区) 或 [5]+编号 (外部 flash)，设备开始发送 'C' 后运行本脚本：
+
+    python3 tools/ota_stream.py /dev/ttyUSB0 app.bin -b 921600
+    python3 tools/ota_stream.py /dev/ttyUSB0 app.bin -B 3000000   # 协商更高波特率
+
+加 -z 时先压缩再发送 (见 lzss.py)，设备边接收边解压。
+串口可以是真实串口，也可以是 PTY (测试时用 --loss 模拟丢帧)。仅依赖标准库。
+"""
+
+import argparse
+import os
+import random
+import select
+import struct
+import sys
+import termios
+import time
+import tty
+
+import lzss
+
+SYNC = 0xA5
+HEAD_LEN = 6
+DATA_MAX = 1024
+
+T_START = 0x01
+T_DATA = 0x02
+T_END = 0x03
+T_BAUD = 0x04
+T_TEST = 0x05
+T_ACK = 0x80
+T_ABORT = 0x81
+T_DONE = 0x82
+T_BAUD_ACK = 0x83
+T_TEST_ACK = 0x84
+
+BAUD_TIMEOUT = 0.5  # 设备端 STREAM_BAUD_TIMEOUT
+TEST_PATTERN = b"\x55\xAA\x00\xFF\x0F\xF0\x33\xCC"
+
+BAUDS = {
+    9600: termios.B9600, 19200: termios.B19200, 38400: termios.B38400,
+    57600: termios.B57600, 115200: termios.B115200, 230400: termios.B230400,
+    460800: termios.B460800, 921600: termios.B921600,
+}
+# 高波特率常量只在部分平台上存在
+for _rate in (1000000, 1152000, 1500000, 2000000, 2500000, 3000000, 3500000, 4000000):
+    if hasattr(termios, "B%d" % _rate):
+        BAUDS[_rate] = getattr(termios, "B%d" % _rate)
+
+
+def crc16_xmodem(data):
+    """CRC-16/XMODEM，与 bootloader 的 xmodem_crc16 一致"""
+    crc = 0
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def build_frame(ftype, seq, payload=b""):
+    body = bytes([ftype]) + struct.pack("<HH", seq & 0xFFFF, len(payload)) + payload
+    return bytes([SYNC]) + body + struct.pack(">H", crc16_xmodem(body))
+
+
+class Port:
+    """原始模式串口/PTY"""
+
+    def __init__(self, path, baud):
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY | os.O_NONBLOCK)
+        if os.isatty(self.fd):
+            tty.setraw(self.fd)
+        self.set_baud(baud)
+
+    def set_baud(self, baud):
+        """切换波特率，等待已写入的数据发完；PTY 上不起作用"""
+        self.baud = baud
+        if os.isatty(self.fd):
+            termios.tcdrain(self.fd)
+            attr = termios.tcgetattr(self.fd)
+            attr[4] = attr[5] = BAUDS[baud]
+            termios.tcsetattr(self.fd, termios.TCSANOW, attr)
+            termios.tcflush(self.fd, termios.TCIFLUSH)
+
+    def write(self, data):
+        view = memoryview(data)
+        while view:
+            select.select([], [self.fd], [])
+            n = os.write(self.fd, view)
+            view = view[n:]
+
+    def drain(self):
+        if os.isatty(self.fd):
+            termios.tcdrain(self.fd)
+
+    def read(self, timeout):
+        r, _, _ = select.select([self.fd], [], [], timeout)
+        if not r:
+            return b""
+        try:
+            return os.read(self.fd, 4096)
+        except BlockingIOError:
+            return b""
+
+    def close(self):
+        os.close(self.fd)
+
+
+class FrameParser:
+    """从设备输出中解析应答帧，跳过命令行文本与 'C'"""
+
+    def __init__(self):
+        self.buf = bytearray()
+
+    def feed(self, data):
+        self.buf += data
+        frames = []
+        while True:
+            start = self.buf.find(bytes([SYNC]))
+            if start < 0:
+                self.buf.clear()
+                break
+            del self.buf[:start]
+            if len(self.buf) < HEAD_LEN:
+                break
+            paylen = self.buf[4] | (self.buf[5] << 8)
+            if paylen > DATA_MAX:
+                del self.buf[:1]
+                continue
+            need = HEAD_LEN + paylen + 2
+            if len(self.buf) < need:
+                break
+            body = bytes(self.buf[1:HEAD_LEN + paylen])
+            crc = (self.buf[HEAD_LEN + paylen] << 8) | self.buf[HEAD_LEN + paylen + 1]
+            if crc == crc16_xmodem(body):
+                seq = self.buf[2] | (self.buf[3] << 8)
+                frames.append((self.buf[1], seq, bytes(self.buf[HEAD_LEN:HEAD_LEN + paylen])))
+                del self.buf[:need]
+            else:
+                del self.buf[:1]
+        return frames
+
+
+class Sender:
+    def __init__(self, port, window, timeout, loss, gap, verbose):
+        self.port = port
+        self.window = window
+        self.timeout = timeout
+        self.loss = loss
+        self.gap = gap
+        self.verbose = verbose
+        self.parser = FrameParser()
+        self.sent = 0
+        self.resent = 0
+
+    def log(self, msg):
+        if self.verbose:
+            print(msg, file=sys.stderr)
+
+    def send_frame(self, frame, droppable=False):
+        self.sent += 1
+        if droppable and random.random() < self.loss:
+            return  # 模拟丢帧
+        self.port.write(frame)
+        # 当前设备以串口空闲中断分帧，帧间保留空闲时间
+        if self.gap > 0:
+            self.port.drain()
+            time.sleep(self.gap)
+
+    def wait_acks(self, timeout, want=T_ACK):
+        deadline = time.monotonic() + timeout
+        acks = []
+        while not acks:
+            left = deadline - time.monotonic()
+            if left <= 0:
+                break
+            for ftype, seq, payload in self.parser.feed(self.port.read(left)):
+                if ftype == T_ABORT:
+                    raise RuntimeError("设备中止传输, 原因 0x%02X" % (payload[0] if payload else 0))
+                if ftype == want:
+                    acks.append((seq, payload))
+        return acks
+
+    def request(self, frame, accept, want=T_ACK, retries=20, timeout=None):
+        """发送控制帧直到收到满足条件的应答，返回应答负载"""
+        for _ in range(retries):
+            self.send_frame(frame)
+            for seq, payload in self.wait_acks(timeout or self.timeout, want):
+                if accept(seq, payload):
+                    return payload
+        raise RuntimeError("设备无应答")
+
+    def test(self, retries):
+        """发送测试帧，返回是否收到正确的回复"""
+        try:
+            self.request(build_frame(T_TEST, 0, TEST_PATTERN),
+                         lambda s, p: p == TEST_PATTERN, want=T_TEST_ACK, retries=retries, timeout=0.1)
+            return True
+        except RuntimeError:
+            return False
+
+    def negotiate(self, baud):
+        """协商波特率，失败时双方恢复原波特率"""
+        old = self.port.baud
+        payload = self.request(build_frame(T_BAUD, 0, struct.pack("<I", baud)),
+                               lambda s, p: len(p) == 4, want=T_BAUD_ACK, retries=5)
+        if struct.unpack("<I", payload)[0] != baud:
+            print("设备不支持 %d 波特率, 保持 %d" % (baud, old))
+            return
+        self.port.set_baud(baud)
+        if self.test(3):
+            print("波特率: %d" % baud)
+            return
+        # 未确认：恢复原波特率，等设备超时后确认双方一致 (设备可能已收到测试帧并保持新波特率)
+        self.port.set_baud(old)
+        time.sleep(BAUD_TIMEOUT + 0.1)
+        if self.test(3):
+            print("波特率 %d 测试失败, 恢复 %d" % (baud, old))
+            return
+        self.port.set_baud(baud)
+        if self.test(3):
+            print("波特率: %d" % baud)
+            return
+        raise RuntimeError("波特率协商失败")
+
+    def run(self, image, baud=None):
+        chunks = [image[i:i + DATA_MAX] for i in range(0, len(image), DATA_MAX)]
+        total = len(chunks)
+        if baud is not None and baud != self.port.baud:
+            self.negotiate(baud)
+        t0 = time.monotonic()
+
+        self.request(build_frame(T_START, 0, struct.pack("<I", len(image))), lambda s, p: s == 0)
+        self.log("START ok, %d 帧" % total)
+
+        base = 0            # 设备已按序收到的帧数
+        nxt = 0             # 下一个首次发送的帧
+        sent_at = {}        # 帧序号 -> 最近发送时间
+        selacked = set()    # 已被选择应答的帧
+
+        while base < total:
+            # 填满窗口
+            while nxt < total and nxt < base + self.window:
+                self.send_frame(build_frame(T_DATA, nxt, chunks[nxt]), droppable=True)
+                sent_at[nxt] = time.monotonic()
+                nxt += 1
+
+            for seq, payload in self.wait_acks(min(self.timeout, 0.05)):
+                bitmap = payload[0] if payload else 0
+                # 16 位序号展开到绝对帧号
+                ack = base + ((seq - base) & 0xFFFF)
+                if ack > nxt:
+                    continue
+                for n in range(base, ack):
+                    sent_at.pop(n, None)
+                    selacked.discard(n)
+                base = ack
+                highest = -1
+                for i in range(self.window - 1):
+                    if bitmap & (1 << i):
+                        selacked.add(base + 1 + i)
+                        highest = base + 1 + i
+                # 比已收帧更早发出却未收到的帧视为丢失，立即选择重传
+                for n in range(base, highest):
+                    if n not in selacked and sent_at[n] < sent_at[highest]:
+                        self.log("重传 %d (位图)" % n)
+                        self.resent += 1
+                        self.send_frame(build_frame(T_DATA, n, chunks[n]), droppable=True)
+                        sent_at[n] = time.monotonic()
+
+            # 超时重传
+            now = time.monotonic()
+            for n in range(base, nxt):
+                if n not in selacked and now - sent_at[n] > self.timeout:
+                    self.log("重传 %d (超时)" % n)
+                    self.resent += 1
+                    self.send_frame(build_frame(T_DATA, n, chunks[n]), droppable=True)
+                    sent_at[n] = time.monotonic()
+
+        self.request(build_frame(T_END, total), lambda s, p: s == total, want=T_DONE)
+        elapsed = time.monotonic() - t0
+        print("完成: %d 字节, %.2f s, %.1f KB/s, 发送 %d 帧, 重传 %d 帧"
+              % (len(image), elapsed, len(image) / 1024 / elapsed, self.sent, self.resent))
+
+
+def main():
+    ap = argparse.ArgumentParser(description="OTA 滑动窗口流式传输发送端")
+    ap.add_argument("port", help="串口或 PTY 路径")
+    ap.add_argument("image", help="bin 固件文件")
+    ap.add_argument("-b", "--baud", type=int, default=921600, choices=sorted(BAUDS))
+    ap.add_argument("-B", "--fast-baud", type=int, choices=sorted(BAUDS), help="传输前协商的波特率")
+    ap.add_argument("-w", "--window", type=int, default=4, help="窗口大小, 不超过设备 STREAM_WINDOW")
+    ap.add_argument("-t", "--timeout", type=float, default=0.5, help="重传超时 (s)")
+    ap.add_argument("--gap", type=float, default=0.0005, help="帧间空闲时间 (s)")
+    ap.add_argument("--loss", type=float, default=0.0, help="模拟丢帧概率 (测试用)")
+    ap.add_argument("-z", "--compress", action="store_true", help="压缩后发送")
+    ap.add_argument("-v", "--verbose", action="store_true")
+    args = ap.parse_args()
+
+    with open(args.image, "rb") as f:
+        image = f.read()
+    if args.compress:
+        raw = len(image)
+        image = lzss.compress(image)
+        print("压缩: %d -> %d 字节 (%.1f%%)" % (raw, len(image), 100.0 * len(image) / max(raw, 1)))
+
+    port = Port(args.port, args.baud)
+    try:
+        Sender(port, args.window, args.timeout, args.loss, args.gap, args.verbose).run(image, args.fast_baud)
+    except RuntimeError as e:
+        print("错误: %s" % e, file=sys.stderr)
+        return 1
+    finally:
+        # 设备在传输结束或中止后恢复原波特率
+        port.set_baud(args.baud)
+        port.close()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())